@@ -0,0 +1,66 @@
+// Throughput of the numeric reduction kernels, scalar against AVX2, over
+// buffers with about 10% nulls. Run it on an otherwise idle machine.
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "include/simd.h"
+#include "src/simd.cpp"
+
+constexpr size_t BENCH_ROWS = 1 << 24;
+constexpr int BENCH_REPEATS = 10;
+
+// Keeps results alive so the timed calls are not optimized away
+static volatile double sink;
+
+template<class Kernel>
+static void measure(const char* kernelName, const char* setName, size_t bytes, Kernel&& kernel) {
+    kernel();
+    auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        sink = kernel();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double gigabytes = static_cast<double>(bytes) * BENCH_REPEATS / 1e9;
+    std::cout << std::left << std::setw(28) << kernelName << std::setw(8) << setName
+              << std::right << std::fixed << std::setprecision(2) << std::setw(8) << gigabytes / elapsed.count() << " GB/s\n";
+}
+
+int main() {
+    std::mt19937_64 rng(42);
+    std::vector<double> doubles(BENCH_ROWS);
+    std::vector<int> ints(BENCH_ROWS);
+    std::vector<uint64_t> validity((BENCH_ROWS + 63) / 64, 0);
+    for (size_t i = 0; i < BENCH_ROWS; i++) {
+        doubles[i] = static_cast<double>(rng() % 1000000) / 100.0;
+        ints[i] = static_cast<int>(rng() % 2000001) - 1000000;
+        if (rng() % 10 != 0) validity[i >> 6] |= 1ULL << (i & 63);
+    }
+
+    std::vector<const NumericKernels*> sets = {&scalarKernels()};
+    if (avx2Kernels() != nullptr) {
+        sets.push_back(avx2Kernels());
+    } else {
+        std::cout << "AVX2 not available, timing the scalar kernels only\n";
+    }
+
+    // bytes read per pass: the values plus the validity words
+    size_t validityBytes = validity.size() * sizeof(uint64_t);
+    size_t doubleBytes = BENCH_ROWS * sizeof(double) + validityBytes;
+    size_t intBytes = BENCH_ROWS * sizeof(int) + validityBytes;
+    const double* d = doubles.data();
+    const int* v = ints.data();
+    const uint64_t* w = validity.data();
+    for (const NumericKernels* k : sets) {
+        measure("countValid", k->name, validityBytes, [&] { return static_cast<double>(k->countValid(w, 0, BENCH_ROWS)); });
+        measure("sum<double>", k->name, doubleBytes, [&] { return k->sumDouble(d, w, 0, BENCH_ROWS); });
+        measure("sum<int>", k->name, intBytes, [&] { return static_cast<double>(k->sumInt(v, w, 0, BENCH_ROWS)); });
+        measure("squaredDeviations<double>", k->name, doubleBytes, [&] { return k->squaredDeviationsDouble(d, w, 0, BENCH_ROWS, 5000.0); });
+        measure("squaredDeviations<int>", k->name, intBytes, [&] { return k->squaredDeviationsInt(v, w, 0, BENCH_ROWS, 0.0); });
+        measure("minMax<double>", k->name, doubleBytes, [&] { return k->minMaxDouble(d, w, 0, BENCH_ROWS).max; });
+        measure("minMax<int>", k->name, intBytes, [&] { return static_cast<double>(k->minMaxInt(v, w, 0, BENCH_ROWS).max); });
+    }
+    return EXIT_SUCCESS;
+}
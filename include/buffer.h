@@ -0,0 +1,235 @@
+#ifndef ABSTRACTPROGRAMMINGPROJECT_BUFFER_H
+#define ABSTRACTPROGRAMMINGPROJECT_BUFFER_H
+
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include "exceptions.h"
+
+using ColumnType = std::variant<int, double, bool, std::string>;
+
+// Physical type of a column. Untyped columns have only seen nulls so far,
+// the first non-null value fixes the kind for the lifetime of the buffer.
+// Dictionary is a physical encoding of String, logically both hold strings.
+enum class ColumnKind {
+    Untyped,
+    Int,
+    Double,
+    Bool,
+    String,
+    Dictionary
+};
+
+// Auto-encoded dictionary columns fall back to plain strings once they have
+// seen this many rows and more than this fraction of them is distinct.
+constexpr size_t DICTIONARY_MIN_ROWS = 1024;
+constexpr double DICTIONARY_MAX_RATIO = 0.5;
+
+// Filtering copies ranges of this many rows as independent tasks, a
+// multiple of 64 so every range starts on a mask word
+constexpr size_t FILTER_RANGE_SIZE = 1 << 16;
+
+// Row index standing for "no row", gathering it produces a null
+constexpr size_t NO_ROW = std::numeric_limits<size_t>::max();
+
+template<class T>
+constexpr ColumnKind kindOf() {
+    if constexpr (std::is_same_v<T, bool>) {
+        return ColumnKind::Bool;
+    } else if constexpr (std::is_integral_v<T>) {
+        return ColumnKind::Int;
+    } else if constexpr (std::is_floating_point_v<T>) {
+        return ColumnKind::Double;
+    } else if constexpr (std::is_convertible_v<T, std::string> && !std::is_same_v<T, ColumnType>) {
+        return ColumnKind::String;
+    } else {
+        return ColumnKind::Untyped;
+    }
+}
+
+ColumnKind kindOf(const ColumnType& value);
+std::string kindName(ColumnKind kind);
+bool isStringKind(ColumnKind kind);
+
+// Converts a variant value to the physical type T of a buffer. Ints widen
+// to doubles, any other mismatch throws TypeMismatchException instead of
+// narrowing the value.
+template<class T>
+T convertValue(const ColumnType& value) {
+    return std::visit([](const auto& v) -> T {
+        using V = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<V, T>) {
+            return v;
+        } else if constexpr (std::is_same_v<V, int> && std::is_same_v<T, double>) {
+            return static_cast<double>(v);
+        } else {
+            throw TypeMismatchException();
+        }
+    }, value);
+}
+
+// Bit-packed null mask, bit set means the slot holds a valid value.
+// Bits past size() are always zero so popcounts can run over whole words.
+class ValidityBitmap {
+private:
+    std::vector<uint64_t> words;
+    size_t length = 0;
+
+public:
+    ValidityBitmap() = default;
+    explicit ValidityBitmap(size_t n, bool valid = true);
+    // Takes over ready made words for n slots, bits past n are cleared
+    ValidityBitmap(std::vector<uint64_t> words, size_t n);
+
+    size_t size() const { return this->length; }
+    bool get(size_t index) const { return (this->words[index >> 6] >> (index & 63)) & 1ULL; }
+    void set(size_t index, bool valid);
+    void append(bool valid);
+    void insert(size_t index, bool valid);
+    void erase(size_t index);
+    void resize(size_t n, bool valid);
+    void reserve(size_t n);
+    void clear();
+    size_t countValid() const;
+    // Clears every bit that is clear in other, both cover the same slots
+    void intersect(const ValidityBitmap& other);
+    bool allValid() const { return this->countValid() == this->length; }
+    const std::vector<uint64_t>& getWords() const { return this->words; }
+
+    // Calls visitor(index) for every set bit in ascending order, a word at a time
+    template<class Visitor> void forEachSet(Visitor&& visitor) const {
+        for (size_t w = 0; w < this->words.size(); w++) {
+            for (uint64_t bits = this->words[w]; bits != 0; bits &= bits - 1) {
+                visitor((w << 6) + static_cast<size_t>(std::countr_zero(bits)));
+            }
+        }
+    }
+};
+
+// Row selection mask with the layout of a validity bitmap, bit set keeps the row
+using Bitmask = ValidityBitmap;
+
+// String storage as integer codes into a table of unique values. Equality,
+// counting and grouping on a dictionary column only touch the codes.
+// Copies, slices, gathers and filters share the table of values, a shared
+// table is copied before a new value is added to it.
+class DictionaryArray {
+private:
+    struct Entries {
+        std::vector<std::string> dictionary;
+        std::unordered_map<std::string, uint32_t> lookup;
+    };
+
+    std::vector<uint32_t> codes;
+    std::shared_ptr<Entries> entries = std::make_shared<Entries>();
+
+    Entries& writeEntries() {
+        if (this->entries.use_count() > 1) {
+            this->entries = std::make_shared<Entries>(*this->entries);
+        }
+        return *this->entries;
+    }
+    // Same table of values, no codes
+    DictionaryArray sharingEntries() const;
+
+public:
+    using value_type = std::string;
+
+    DictionaryArray() = default;
+    explicit DictionaryArray(size_t n);
+    explicit DictionaryArray(const std::vector<std::string>& values);
+
+    size_t size() const { return this->codes.size(); }
+    const std::string& operator[](size_t index) const { return this->entries->dictionary[this->codes[index]]; }
+    const std::vector<uint32_t>& getCodes() const { return this->codes; }
+    const std::vector<std::string>& getDictionary() const { return this->entries->dictionary; }
+    size_t cardinality() const { return this->entries->dictionary.size(); }
+
+    uint32_t encode(const std::string& value);
+    std::optional<uint32_t> codeOf(const std::string& value) const;
+    void push_back(const std::string& value) { this->codes.push_back(this->encode(value)); }
+    void emplace_back() { this->push_back(std::string()); }
+    void assign(size_t index, const std::string& value) { this->codes[index] = this->encode(value); }
+    void insertAt(size_t index, const std::string& value);
+    void eraseAt(size_t index);
+    void recode(uint32_t from, uint32_t to, const ValidityBitmap& validity);
+    void reserve(size_t n) { this->codes.reserve(n); }
+    std::vector<std::string> decode() const;
+    DictionaryArray gather(const std::vector<size_t>& indices) const;
+    DictionaryArray filter(const Bitmask& mask, size_t threads = 1) const;
+    DictionaryArray slice(size_t offset, size_t length) const;
+};
+
+// Contiguous typed storage of a single column. Null slots keep a default
+// constructed value in the data vector, so typed kernels can scan the data
+// without branching and consult the bitmap only where nulls matter.
+class ColumnBuffer {
+public:
+    using Storage = std::variant<std::monostate,
+                                 std::vector<int>,
+                                 std::vector<double>,
+                                 std::vector<bool>,
+                                 std::vector<std::string>,
+                                 DictionaryArray>;
+
+private:
+    Storage data;
+    ValidityBitmap validity;
+    bool autoDictionary = false;
+
+    void checkDictionaryCardinality();
+
+public:
+    ColumnBuffer() = default;
+    explicit ColumnBuffer(ColumnKind kind);
+    ColumnBuffer(Storage data, ValidityBitmap validity) : data(std::move(data)), validity(std::move(validity)) {}
+
+    ColumnKind kind() const { return static_cast<ColumnKind>(this->data.index()); }
+    bool isTyped() const { return this->kind() != ColumnKind::Untyped; }
+    void fixKind(ColumnKind kind);
+    size_t size() const { return this->validity.size(); }
+    bool isValid(size_t index) const { return this->validity.get(index); }
+    const ValidityBitmap& getValidity() const { return this->validity; }
+
+    template<class T> const std::vector<T>& values() const { return std::get<std::vector<T>>(this->data); }
+    const DictionaryArray& getDictionary() const { return std::get<DictionaryArray>(this->data); }
+    template<class Visitor> decltype(auto) visit(Visitor&& visitor) const {
+        return std::visit(std::forward<Visitor>(visitor), this->data);
+    }
+
+    std::optional<ColumnType> get(size_t index) const;
+    void append(const std::optional<ColumnType>& value);
+    void appendNull();
+    void set(size_t index, const std::optional<ColumnType>& value);
+    void insert(size_t index, const std::optional<ColumnType>& value);
+    void erase(size_t index);
+    void replaceAll(const ColumnType& oldValue, const ColumnType& newValue);
+    void markAllValid();
+    void reserve(size_t n);
+
+    // New buffer holding the cells at the given rows in that order
+    ColumnBuffer gather(const std::vector<size_t>& indices) const;
+    // New buffer holding the cells of the rows selected by the mask. Ranges of
+    // FILTER_RANGE_SIZE rows are copied in parallel, each one starting at the
+    // number of rows selected before it, 0 threads means one per hardware thread.
+    ColumnBuffer filter(const Bitmask& mask, size_t threads = 1) const;
+    // New buffer holding a copy of rows [offset, offset + length)
+    ColumnBuffer slice(size_t offset, size_t length) const;
+    // Turns the rows whose bit is clear in the mask into nulls, in place
+    void where(const Bitmask& mask);
+
+    // Untyped buffers that receive strings start out dictionary encoded and
+    // decode themselves if the column turns out to have high cardinality.
+    void setAutoDictionary(bool enabled) { this->autoDictionary = enabled; }
+    void encodeDictionary();
+    void decodeDictionary();
+};
+
+#endif //ABSTRACTPROGRAMMINGPROJECT_BUFFER_H
@@ -1,11 +1,17 @@
 #ifndef ABSTRACTPROGRAMMINGPROJECT_COLUMN_H
 #define ABSTRACTPROGRAMMINGPROJECT_COLUMN_H
 
+#include <cmath>
 #include <iostream>
 #include <vector>
 #include <map>
 #include <iterator>
+#include <memory>
 #include "exceptions.h"
+#include "buffer.h"
+#include "sketch.h"
+#include "hashtable.h"
+#include "expression.h"
 #include <random>
 
 template<typename T>
@@ -33,12 +39,78 @@ concept Sortable =
 
 using ColumnType = std::variant<int, double, bool, std::string>;
 
+// Rows are summarized in chunks of this many rows: a sum pass and a squared
+// deviation pass over data still in cache, then a merge into the running state
+constexpr size_t STATS_CHUNK_SIZE = 4096;
+
+// Everything describe() needs from one pass over a column. Mean and variance
+// are NaN for non-numeric kinds, the extremes are kept as rows so strings
+// have them too.
+struct ColumnStats {
+    size_t count = 0;
+    size_t nullCount = 0;
+    double sum = 0.0;
+    // sum of squared deviations from the mean
+    double m2 = 0.0;
+    size_t minRow = NO_ROW;
+    size_t maxRow = NO_ROW;
+    bool numeric = false;
+
+    double mean() const { return !this->numeric || this->count == 0 ? std::nan("") : this->sum / static_cast<double>(this->count); }
+    double variance() const { return !this->numeric || this->count < 2 ? std::nan("") : this->m2 / static_cast<double>(this->count - 1); }
+    double stddev() const { return std::sqrt(this->variance()); }
+
+    // Pairwise update of Chan et al., less orders two rows of the column
+    template<class Less> void merge(const ColumnStats& other, Less less) {
+        if (other.count > 0 && this->count > 0) {
+            double delta = other.mean() - this->mean();
+            double total = static_cast<double>(this->count + other.count);
+            this->m2 += other.m2 + delta * delta * static_cast<double>(this->count) * static_cast<double>(other.count) / total;
+        } else if (other.count > 0) {
+            this->m2 = other.m2;
+        }
+        this->count += other.count;
+        this->nullCount += other.nullCount;
+        this->numeric = this->numeric || other.numeric;
+        this->sum += other.sum;
+        if (other.minRow != NO_ROW && (this->minRow == NO_ROW || less(other.minRow, this->minRow))) {
+            this->minRow = other.minRow;
+        }
+        if (other.maxRow != NO_ROW && (this->maxRow == NO_ROW || less(this->maxRow, other.maxRow))) {
+            this->maxRow = other.maxRow;
+        }
+    }
+};
+
+// Summary of rows [begin, end) of a buffer, extremes are rows of the buffer.
+// Splits into tasks of at least SORT_RANGE_SIZE rows, 0 threads means one per
+// hardware thread.
+ColumnStats rangeStats(const ColumnBuffer& buffer, size_t begin, size_t end, size_t threads = 1);
+
+// Order of the (value, count) pairs returned by valueCounts. Unordered is
+// the cheapest, Frequency puts the most common value first like pandas.
+enum class ValueCountOrder {
+    Unordered,
+    Frequency,
+    Value
+};
+
 template<class DataType>
 class Column {
 private:
     std::string name;
-    std::vector<std::optional<DataType>> values;
-    bool isPartOfDataFrame;
+    // Shared with copies of the column and with views taken of it, a shared
+    // buffer is copied before the column changes it so the others keep what
+    // they saw
+    std::shared_ptr<ColumnBuffer> storage = std::make_shared<ColumnBuffer>(kindOf<DataType>());
+    bool isPartOfDataFrame = false;
+
+    ColumnBuffer& writeBuffer() {
+        if (this->storage.use_count() > 1) {
+            this->storage = std::make_shared<ColumnBuffer>(*this->storage);
+        }
+        return *this->storage;
+    }
 
     std::string generateRandomName(size_t length = 8) {
         const std::string chars = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
@@ -53,15 +125,37 @@ private:
         return randomName;
     }
 
+    template<class T> static DataType fromStored(const T& value);
+    template<class T> static std::optional<T> toStored(const DataType& value);
+    static DataType fromDouble(double value) requires DecayedOrDirectNumeric<DataType>;
+    template<class Visitor> void forEachValid(Visitor&& visitor) const;
+    std::vector<double> numericValues() const;
+    std::vector<size_t> codeCounts() const;
+    template<class T> static DataType fromKey(const T& key);
+    template<class Visitor> void forEachValueCount(Visitor&& visitor, size_t threads = 1) const;
+
 public:
     // CONSTRUCTORS
     Column() : name(generateRandomName()) {}
     Column(const std::string& columnName)
             : name(columnName) {}
     Column(const std::string& columnName, const std::vector<std::optional<DataType>>& values)
-            : name(columnName), values(values) {}
+            : name(columnName) {
+        this->writeBuffer().reserve(values.size());
+        for (const auto& value : values) {
+            this->addToColumnFromRow(value);
+        }
+    }
+    Column(const std::string& columnName, const ColumnBuffer& buffer)
+            : name(columnName), storage(std::make_shared<ColumnBuffer>(buffer)) {}
+    Column(const std::string& columnName, ColumnBuffer&& buffer)
+            : name(columnName), storage(std::make_shared<ColumnBuffer>(std::move(buffer))) {}
+    // Shares the buffer until either side changes it
+    Column(const std::string& columnName, std::shared_ptr<const ColumnBuffer> buffer)
+            : name(columnName), storage(std::const_pointer_cast<ColumnBuffer>(std::move(buffer))) {}
 //    Column(std::string name, std::vector<DataType> values)
 //            : name(name), values(values) {}
+    // Copies share the buffer, the first write on either side duplicates it
     Column(const Column& other) = default;
     Column& operator=(const Column& other) = default;
     Column(Column&& other) noexcept = default;
@@ -81,11 +175,20 @@ public:
     void checkDataFrameIntegrity() const;
     size_t getWidth() const;
     std::string getName() const { return this->name; }
+    ColumnKind getKind() const { return this->storage->kind(); }
+    const ColumnBuffer& getBuffer() const { return *this->storage; }
+    // The buffer itself, views holding it keep it alive after the column changes
+    std::shared_ptr<const ColumnBuffer> shareBuffer() const { return this->storage; }
+    bool isDictionaryEncoded() const { return this->storage->kind() == ColumnKind::Dictionary; }
+    void encodeDictionary() { this->writeBuffer().encodeDictionary(); }
+    void decodeDictionary() { this->writeBuffer().decodeDictionary(); }
+    void setAutoDictionary(bool enabled) { this->writeBuffer().setAutoDictionary(enabled); }
 
     // DATA MANIPULATION
     std::vector<size_t> find(const DataType& element) const;
     void add(const std::optional<ColumnType>& element);
     void addToColumnFromRow(const std::optional<DataType>& value);
+    void reserve(size_t n) { this->writeBuffer().reserve(n); }
     void add(const std::optional<ColumnType>& element, size_t index);
     void removeAt(size_t index);
     void removeAtFromRow(size_t index);
@@ -108,17 +211,28 @@ public:
     double std() const requires DecayedOrDirectNumeric<DataType>;
     double var() const requires DecayedOrDirectNumeric<DataType>;
     DataType percentile(double p) const requires DecayedOrDirectNumeric<DataType>;
+    // Interpolated quantiles for every p in [0, 1], in the order requested
+    std::vector<double> percentiles(const std::vector<double>& ps) const requires DecayedOrDirectNumeric<DataType>;
+    // Quantile sketch of the non-null values, rank error below accuracy with 99% confidence
+    QuantileSketch quantileSketch(double accuracy = 0.01, size_t threads = 1) const requires DecayedOrDirectNumeric<DataType>;
+    double approxPercentile(double p, double accuracy = 0.01) const requires DecayedOrDirectNumeric<DataType>;
     double skewness() const requires DecayedOrDirectNumeric<DataType>;
     DataType range() const requires DecayedOrDirectNumeric<DataType>;
     DataType mode() const;
+    // Count, nulls, extremes, sum and variance from a single pass without copies
+    ColumnStats stats(size_t threads = 1) const;
 
     // COUNT BASED AGGREGATIONS
     int countNonNull() const;
     int countNull() const;
     int countDistinct() const;
+    // HyperLogLog estimate from one pass, relative error about 1.04 / sqrt(2^precision)
+    size_t approxCountDistinct(unsigned precision = DISTINCT_SKETCH_DEFAULT_PRECISION, size_t threads = 1) const;
+    DistinctSketch distinctSketch(unsigned precision = DISTINCT_SKETCH_DEFAULT_PRECISION, size_t threads = 1) const;
 
     // FREQUENCY
     std::map<DataType, size_t> valueCounts() const;
+    std::vector<std::pair<DataType, size_t>> valueCounts(ValueCountOrder order, size_t threads = 1) const;
     std::vector<size_t> histogram(size_t numberOfBins) const requires DecayedOrDirectNumeric<DataType>;
 
     // STRING BASED METHODS
@@ -126,21 +240,30 @@ public:
 
     // SORT
     Column<DataType> sort(bool ascending) requires Sortable<DataType>;
+    // The k largest (or smallest) non-null values, best first, without sorting the column
+    Column<DataType> topK(size_t k, bool largest = true, size_t threads = 1) const;
 
     // FILTER
     template<class Predicate> Column<DataType> filter(Predicate pred) const;
+    // Rows at the given positions in that order, NO_ROW gives a null
+    Column<DataType> take(const std::vector<size_t>& indices) const;
+    // Rows whose bit is set in the mask, the mask has one bit per row
+    Column<DataType> filter(const Bitmask& mask) const;
+    // Sets the rows whose bit is clear in the mask to null, like pandas where
+    void where(const Bitmask& mask) { this->writeBuffer().where(mask); }
 
     // OPERATORS
     Column<DataType> applyOperation(const DataType& value, std::function<DataType(const DataType&, const DataType&)> op) const requires DecayedOrDirectNumeric<DataType>;
     Column<DataType> applyOperation(const Column<DataType>& other, std::function<DataType(const DataType&, const DataType&)> op) const requires DecayedOrDirectNumeric<DataType>;
-    Column<DataType> operator+(const DataType& value) const requires DecayedOrDirectNumeric<DataType>;
-    Column<DataType> operator-(const DataType& value) const requires DecayedOrDirectNumeric<DataType>;
-    Column<DataType> operator*(const DataType& value) const requires DecayedOrDirectNumeric<DataType>;
-    Column<DataType> operator/(const DataType& value) const requires DecayedOrDirectNumeric<DataType>;
-    Column<DataType> operator+(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType>;
-    Column<DataType> operator-(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType>;
-    Column<DataType> operator*(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType>;
-    Column<DataType> operator/(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType>;
+    // int and double columns use the fused expressions of expression.h instead
+    Column<DataType> operator+(const DataType& value) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>);
+    Column<DataType> operator-(const DataType& value) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>);
+    Column<DataType> operator*(const DataType& value) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>);
+    Column<DataType> operator/(const DataType& value) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>);
+    Column<DataType> operator+(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>);
+    Column<DataType> operator-(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>);
+    Column<DataType> operator*(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>);
+    Column<DataType> operator/(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>);
     std::optional<DataType> operator[](size_t index) const;
 };
 
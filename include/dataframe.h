@@ -1,31 +1,128 @@
 #ifndef ABSTRACTPROGRAMMINGPROJECT_DATAFRAME_H
 #define ABSTRACTPROGRAMMINGPROJECT_DATAFRAME_H
 
+#include <compare>
 #include <iostream>
 #include "column.h"
+#include "predicate.h"
+#include "view.h"
 #include <tuple>
 #include <map>
+#include <unordered_map>
 #include <any>
+#include <memory>
 
 using ColumnType = std::variant<int, double, bool, std::string>;
 
+// Column order shared by a RowRange and every RowView it hands out, rows are
+// counted from offset in every buffer
+struct RowLayout {
+    std::vector<std::string> names;
+    std::vector<const ColumnBuffer*> buffers;
+    size_t offset = 0;
+};
+
+// Non-owning view of a single row. Cells are read in place from the column
+// buffers, nothing is copied until a cell is requested. A view is valid as
+// long as the RowRange it came from and the DataFrame are not modified.
+class RowView {
+private:
+    const RowLayout* layout;
+    size_t row;
+
+public:
+    RowView(const RowLayout* layout, size_t row) : layout(layout), row(row) {}
+
+    size_t getIndex() const { return this->row; }
+    size_t size() const { return this->layout->buffers.size(); }
+    const std::vector<std::string>& columnNames() const { return this->layout->names; }
+    bool isNull(size_t position) const { return !this->layout->buffers[position]->isValid(this->layout->offset + this->row); }
+    std::optional<ColumnType> operator[](size_t position) const { return this->layout->buffers[position]->get(this->layout->offset + this->row); }
+    std::optional<ColumnType> operator[](const std::string& columnName) const;
+    template<class T> std::optional<T> get(const std::string& columnName) const;
+    std::vector<std::optional<ColumnType>> toVector() const;
+    std::map<std::string, std::optional<ColumnType>> toMap() const;
+};
+
+class RowIterator {
+private:
+    const RowLayout* layout = nullptr;
+    size_t row = 0;
+
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = RowView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = RowView;
+
+    RowIterator() = default;
+    RowIterator(const RowLayout* layout, size_t row) : layout(layout), row(row) {}
+
+    RowView operator*() const { return RowView(this->layout, this->row); }
+    RowView operator[](difference_type n) const { return RowView(this->layout, this->row + n); }
+    RowIterator& operator++() { ++this->row; return *this; }
+    RowIterator operator++(int) { RowIterator copy = *this; ++this->row; return copy; }
+    RowIterator& operator--() { --this->row; return *this; }
+    RowIterator operator--(int) { RowIterator copy = *this; --this->row; return copy; }
+    RowIterator& operator+=(difference_type n) { this->row += n; return *this; }
+    RowIterator& operator-=(difference_type n) { this->row -= n; return *this; }
+    RowIterator operator+(difference_type n) const { return RowIterator(this->layout, this->row + n); }
+    friend RowIterator operator+(difference_type n, const RowIterator& it) { return it + n; }
+    RowIterator operator-(difference_type n) const { return RowIterator(this->layout, this->row - n); }
+    difference_type operator-(const RowIterator& other) const { return static_cast<difference_type>(this->row) - static_cast<difference_type>(other.row); }
+    bool operator==(const RowIterator& other) const { return this->row == other.row; }
+    std::strong_ordering operator<=>(const RowIterator& other) const { return this->row <=> other.row; }
+};
+
+class RowRange {
+private:
+    std::shared_ptr<RowLayout> layout;
+    size_t numberOfRows;
+
+public:
+    RowRange(std::shared_ptr<RowLayout> layout, size_t numberOfRows)
+            : layout(std::move(layout)), numberOfRows(numberOfRows) {}
+
+    RowIterator begin() const { return RowIterator(this->layout.get(), 0); }
+    RowIterator end() const { return RowIterator(this->layout.get(), this->numberOfRows); }
+    RowView operator[](size_t index) const;
+    size_t size() const { return this->numberOfRows; }
+};
+
+class GroupBy;
+struct JoinIndices;
+
 class DataFrame {
 private:
+    friend class GroupBy;
+    friend class Condition;
+
     std::string name;
-    std::map<std::string, Column<ColumnType>> columns;
-    std::map<std::string, size_t> columnIndex;
+    // Columns in insertion order, columnIndex maps each name to its slot
+    std::vector<Column<ColumnType>> columns;
+    std::unordered_map<std::string, size_t> columnIndex;
 
-    std::vector<double> aggregateSum(const std::vector<std::vector<std::optional<ColumnType>>>& groupRows) const;
-    std::vector<double> aggregateCount(const std::vector<std::vector<std::optional<ColumnType>>>& groupRows) const;
-    std::vector<double> aggregateMean(const std::vector<std::vector<std::optional<ColumnType>>>& groupRows) const;
+    void placeColumn(Column<ColumnType> column);
+
+    void enableAutoDictionary();
+    static bool isTypeMismatch(const Column<ColumnType>& column, const ColumnType& value);
+    static std::optional<ColumnType> parseCell(const std::string& cell);
+    static void appendCells(Column<ColumnType>& column, const std::vector<std::optional<ColumnType>>& cells);
+    void addBuffer(const std::string& columnName, ColumnBuffer buffer);
+    void addBuffer(const std::string& columnName, std::shared_ptr<const ColumnBuffer> buffer);
+    std::vector<const ColumnBuffer*> keyBuffers(const std::vector<std::string>& keys) const;
+    std::vector<size_t> ascendingOrder(const std::vector<std::string>& keys, bool assumeSorted) const;
+    DataFrame joinedFrame(const DataFrame& other, const JoinIndices& indices, bool includeRight,
+                          const std::vector<std::string>& droppedRightColumns, size_t threads) const;
 
 public:
     DataFrame() {}
 
     DataFrame(DataFrame& other, const std::string& groupByColumn) {
-        for(const auto& columnPair : other.columns) {
-            if(columnPair.first != groupByColumn) {
-                this->addColumn(columnPair.first);
+        for(const auto& column : other.columns) {
+            if(column.getName() != groupByColumn) {
+                this->addColumn(column.getName());
             }
         }
     }
@@ -46,16 +143,33 @@ public:
     template<class T> void addColumn(const Column<T>& column);
     void addColumn(const std::string& name);
     void addColumn();
+    RowRange rows() const;
+    RowRange rowsExcept(const std::string& columnName) const;
     std::vector<std::optional<ColumnType>> getRow(size_t index) const;
     std::vector<std::optional<ColumnType>> getRowWithoutGroupByColumn(size_t index, const std::string& columnName) const;
     void addRow(const std::vector<std::optional<ColumnType>>& row);
     void addRow(const std::map<std::string, std::optional<ColumnType>>& row);
+    void appendBatch(const std::vector<std::vector<std::optional<ColumnType>>>& batch);
+    void appendBatch(const std::map<std::string, std::vector<std::optional<ColumnType>>>& batch);
     void removeRow(size_t index);
     Column<ColumnType> removeColumn(const std::string& columnName);
     Column<ColumnType> removeColumn(size_t index);
     DataFrame selectColumns(const std::vector<std::string>& columnNames);
     DataFrame selectColumns(const std::vector<size_t>& indexes);
     template<typename Predicate> DataFrame filterRows(const Predicate& pred) const;
+    // Typed gathers over every column, 0 threads means one per hardware thread
+    DataFrame take(const std::vector<size_t>& indices, size_t threads = 1) const;
+    DataFrame filter(const Bitmask& mask, size_t threads = 1) const;
+    // Rows meeting a column condition such as col("latency") > 200 && col("status") == "ok"
+    DataFrame filter(const Condition& condition, size_t threads = 1) const;
+
+    // VIEWS
+    // O(1) read-only windows sharing the column buffers, see DataFrameView
+    DataFrameView view() const;
+    DataFrameView view(const std::vector<std::string>& columnNames) const;
+    DataFrameView head(size_t n = 5) const;
+    DataFrameView tail(size_t n = 5) const;
+    DataFrameView slice(size_t offset, size_t length) const;
     //DataFrame filterRows(const std::function<bool(const std::vector<std::optional<ColumnType>>&)>& pred) const;
 
     // STATISTICS
@@ -73,14 +187,68 @@ public:
 
     // SORTING
     DataFrame sortBy(const std::string& columnName, bool ascending = true) const;
+    // Empty ascending sorts every column ascending. Ties keep their order for
+    // any number of threads, 0 threads means one per hardware thread.
+    DataFrame sortBy(const std::vector<std::string>& columnNames, const std::vector<bool>& ascending = {}, bool nullsFirst = false,
+                     size_t threads = 1) const;
+    // Braced lists would otherwise bind to the single column overload
+    DataFrame sortBy(std::initializer_list<std::string> columnNames, std::initializer_list<bool> ascending = {}, bool nullsFirst = false,
+                     size_t threads = 1) const;
+    // The n rows with the largest (smallest) values in the given columns, best
+    // first. Rows with a null in those columns are left out.
+    DataFrame nlargest(size_t n, const std::vector<std::string>& columnNames, size_t threads = 1) const;
+    DataFrame nsmallest(size_t n, const std::vector<std::string>& columnNames, size_t threads = 1) const;
 
     // FILES
     static DataFrame readCSV(const std::string& filePath, const std::string& separator = ",", bool hasHeaderLine = true);
     void saveCSV(const std::string& filePath, const std::string& separator = ",", bool saveHeaderLine = true);
 
+    // Sets the cells of the column that fail the predicate to null, in place
     void filterColumn(const std::string& columnName, std::function<bool(const ColumnType&)> predicate);
+    // Same with a condition evaluated over whole columns, it may test other columns too
+    void filterColumn(const std::string& columnName, const Condition& condition, size_t threads = 1);
+    // Nulls the rows whose bit is clear in the mask in every listed column, so one
+    // evaluated condition can mask several columns
+    void filterColumns(const std::vector<std::string>& columnNames, const Bitmask& mask, size_t threads = 1);
 
     DataFrame groupBy(const std::string& columnName, const std::string& aggregation);
+    GroupBy groupBy(const std::vector<std::string>& keys, bool sortGroups = true) const;
+
+    // JOINS
+    // how is "inner", "left", "semi" or "anti"; threads = 0 uses every hardware thread
+    DataFrame join(const DataFrame& other, const std::vector<std::string>& leftKeys, const std::vector<std::string>& rightKeys,
+                   const std::string& how = "inner", size_t threads = 1) const;
+    // Linear merge without hashing, rows come out in key order. Inputs that are
+    // not in ascending key order get sorted first unless declared sorted.
+    DataFrame mergeJoin(const DataFrame& other, const std::vector<std::string>& leftKeys, const std::vector<std::string>& rightKeys,
+                        const std::string& how = "inner", bool assumeSorted = false) const;
+    // Left join with the last right row whose `on` value is not after the left
+    // one, matched on the `by` columns and at most `tolerance` behind.
+    // assumeSorted declares both frames sorted by `on`.
+    DataFrame asofJoin(const DataFrame& other, const std::string& on, const std::vector<std::string>& by = {},
+                       std::optional<double> tolerance = std::nullopt, bool assumeSorted = false) const;
+};
+
+// Pending grouping of a DataFrame or a view by one or more key columns.
+// agg() runs a single scan that computes every requested aggregation, the
+// result holds the key columns plus one "<column>_<op>" column per
+// aggregation. Groups come out sorted by key unless sorting was switched
+// off, then they keep the order in which they first appear. parallel()
+// spreads the scan over worker threads, 0 means one per hardware thread.
+class GroupBy {
+private:
+    DataFrameView source;
+    std::vector<std::string> keys;
+    bool sortGroups;
+    size_t threads = 1;
+
+public:
+    GroupBy(DataFrameView source, std::vector<std::string> keys, bool sortGroups)
+            : source(std::move(source)), keys(std::move(keys)), sortGroups(sortGroups) {}
+
+    GroupBy& parallel(size_t numberOfThreads = 0);
+
+    DataFrame agg(const std::vector<std::pair<std::string, std::string>>& aggregations) const;
 };
 
 #endif //ABSTRACTPROGRAMMINGPROJECT_DATAFRAME_H
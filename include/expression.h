@@ -0,0 +1,213 @@
+#ifndef ABSTRACTPROGRAMMINGPROJECT_EXPRESSION_H
+#define ABSTRACTPROGRAMMINGPROJECT_EXPRESSION_H
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include "buffer.h"
+
+template<class DataType> class Column;
+
+// Columns whose buffer stores exactly their value type, only these take part
+// in fused expressions
+template<typename T>
+concept FusedNumeric = std::is_same_v<T, int> || std::is_same_v<T, double>;
+
+// Lazy element-wise expression over columns of one value type. value(i) is
+// the result at row i whether or not the row is valid, validWord(w) the
+// validity of rows 64w to 64w + 63.
+template<typename E>
+concept ColumnExpression = requires(const E& e, size_t i) {
+    typename E::value_type;
+    { e.value(i) } -> std::convertible_to<typename E::value_type>;
+    { e.validWord(i) } -> std::same_as<uint64_t>;
+    { e.size() } -> std::same_as<size_t>;
+    { e.name() } -> std::convertible_to<std::string>;
+};
+
+// Leaf reading a column in place, the column has to outlive the expression
+// and must not change before it is evaluated
+template<FusedNumeric T>
+class ColumnOperand {
+private:
+    const T* data;
+    const uint64_t* words;
+    size_t length;
+    const Column<T>* column;
+
+public:
+    using value_type = T;
+
+    explicit ColumnOperand(const Column<T>& column)
+            : data(column.getBuffer().template values<T>().data()),
+              words(column.getBuffer().getValidity().getWords().data()),
+              length(column.size()),
+              column(&column) {}
+
+    T value(size_t i) const { return this->data[i]; }
+    uint64_t validWord(size_t w) const { return this->words[w]; }
+    size_t size() const { return this->length; }
+    std::string name() const { return this->column->getName(); }
+};
+
+// Leaf repeating one value on every row
+template<FusedNumeric T>
+class ScalarOperand {
+private:
+    T constant;
+
+public:
+    using value_type = T;
+
+    explicit ScalarOperand(T constant) : constant(constant) {}
+
+    T value(size_t) const { return this->constant; }
+    uint64_t validWord(size_t) const { return ~uint64_t(0); }
+    // matches columns of any length
+    size_t size() const { return SIZE_MAX; }
+    std::string name() const { return std::string(); }
+};
+
+// Op applied to two subexpressions, a row is valid when it is valid on both
+// sides. Integer division by zero yields null instead of trapping.
+template<class Op, ColumnExpression Left, ColumnExpression Right>
+class [[nodiscard]] BinaryExpression {
+private:
+    Left left;
+    Right right;
+
+    static constexpr bool checksDivisor = std::is_same_v<Op, std::divides<>> && std::is_integral_v<typename Left::value_type>;
+
+public:
+    using value_type = typename Left::value_type;
+
+    BinaryExpression(Left left, Right right) : left(std::move(left)), right(std::move(right)) {
+        if (this->left.size() != SIZE_MAX && this->right.size() != SIZE_MAX && this->left.size() != this->right.size()) {
+            throw InvalidSizeException();
+        }
+    }
+
+    value_type value(size_t i) const {
+        if constexpr (checksDivisor) {
+            value_type divisor = this->right.value(i);
+            return divisor == 0 ? value_type() : this->left.value(i) / divisor;
+        } else {
+            return Op()(this->left.value(i), this->right.value(i));
+        }
+    }
+
+    uint64_t validWord(size_t w) const {
+        uint64_t bits = this->left.validWord(w) & this->right.validWord(w);
+        if constexpr (checksDivisor) {
+            for (uint64_t rest = bits; rest != 0; rest &= rest - 1) {
+                size_t i = (w << 6) + static_cast<size_t>(std::countr_zero(rest));
+                if (this->right.value(i) == 0) {
+                    bits &= ~(1ULL << (i & 63));
+                }
+            }
+        }
+        return bits;
+    }
+
+    size_t size() const { return std::min(this->left.size(), this->right.size()); }
+
+    // Named like the eager operators were: lhs_operation_rhs, or lhs_operation with a scalar
+    std::string name() const {
+        std::string lhs = this->left.name();
+        std::string rhs = this->right.name();
+        if (lhs.empty() || rhs.empty()) {
+            return lhs + rhs + "_operation";
+        }
+        return lhs + "_operation_" + rhs;
+    }
+
+    // Runs the whole tree in one loop into a new column
+    Column<value_type> evaluate() const;
+    operator Column<value_type>() const { return this->evaluate(); }
+};
+
+template<class T> struct IsFusedColumn : std::false_type {};
+template<FusedNumeric T> struct IsFusedColumn<Column<T>> : std::true_type {};
+
+template<typename T>
+concept ExpressionOperand = ColumnExpression<T> || IsFusedColumn<T>::value;
+
+template<class T> struct OperandValue { using type = typename T::value_type; };
+template<class T> struct OperandValue<Column<T>> { using type = T; };
+
+template<class T, class Operand>
+auto toOperand(const Operand& operand) {
+    if constexpr (ColumnExpression<Operand>) {
+        return operand;
+    } else if constexpr (IsFusedColumn<Operand>::value) {
+        return ColumnOperand<T>(operand);
+    } else {
+        return ScalarOperand<T>(static_cast<T>(operand));
+    }
+}
+
+// Either two operands of the same value type, or one operand and a number
+// that is converted to the value type of the other side
+template<class L, class R>
+concept ExpressionArguments =
+        (ExpressionOperand<L> && ExpressionOperand<R> && std::is_same_v<typename OperandValue<L>::type, typename OperandValue<R>::type>)
+        || (ExpressionOperand<L> && std::is_arithmetic_v<R>)
+        || (std::is_arithmetic_v<L> && ExpressionOperand<R>);
+
+template<class L, class R>
+using ExpressionValue = typename OperandValue<std::conditional_t<std::is_arithmetic_v<L>, R, L>>::type;
+
+template<class Op, class L, class R>
+auto makeExpression(const L& lhs, const R& rhs) {
+    using T = ExpressionValue<L, R>;
+    auto left = toOperand<T>(lhs);
+    auto right = toOperand<T>(rhs);
+    return BinaryExpression<Op, decltype(left), decltype(right)>(left, right);
+}
+
+template<class L, class R> requires ExpressionArguments<L, R>
+auto operator+(const L& lhs, const R& rhs) { return makeExpression<std::plus<>>(lhs, rhs); }
+
+template<class L, class R> requires ExpressionArguments<L, R>
+auto operator-(const L& lhs, const R& rhs) { return makeExpression<std::minus<>>(lhs, rhs); }
+
+template<class L, class R> requires ExpressionArguments<L, R>
+auto operator*(const L& lhs, const R& rhs) { return makeExpression<std::multiplies<>>(lhs, rhs); }
+
+template<class L, class R> requires ExpressionArguments<L, R>
+auto operator/(const L& lhs, const R& rhs) { return makeExpression<std::divides<>>(lhs, rhs); }
+
+// A temporary column would be gone before the expression reads it, name the
+// column first
+template<FusedNumeric T, class R> requires ExpressionArguments<Column<T>, R>
+void operator+(Column<T>&& lhs, const R& rhs) = delete;
+template<class L, FusedNumeric T> requires ExpressionArguments<L, Column<T>>
+void operator+(const L& lhs, Column<T>&& rhs) = delete;
+template<FusedNumeric T>
+void operator+(Column<T>&& lhs, Column<T>&& rhs) = delete;
+
+template<FusedNumeric T, class R> requires ExpressionArguments<Column<T>, R>
+void operator-(Column<T>&& lhs, const R& rhs) = delete;
+template<class L, FusedNumeric T> requires ExpressionArguments<L, Column<T>>
+void operator-(const L& lhs, Column<T>&& rhs) = delete;
+template<FusedNumeric T>
+void operator-(Column<T>&& lhs, Column<T>&& rhs) = delete;
+
+template<FusedNumeric T, class R> requires ExpressionArguments<Column<T>, R>
+void operator*(Column<T>&& lhs, const R& rhs) = delete;
+template<class L, FusedNumeric T> requires ExpressionArguments<L, Column<T>>
+void operator*(const L& lhs, Column<T>&& rhs) = delete;
+template<FusedNumeric T>
+void operator*(Column<T>&& lhs, Column<T>&& rhs) = delete;
+
+template<FusedNumeric T, class R> requires ExpressionArguments<Column<T>, R>
+void operator/(Column<T>&& lhs, const R& rhs) = delete;
+template<class L, FusedNumeric T> requires ExpressionArguments<L, Column<T>>
+void operator/(const L& lhs, Column<T>&& rhs) = delete;
+template<FusedNumeric T>
+void operator/(Column<T>&& lhs, Column<T>&& rhs) = delete;
+
+#endif //ABSTRACTPROGRAMMINGPROJECT_EXPRESSION_H
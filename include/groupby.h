@@ -0,0 +1,146 @@
+#ifndef ABSTRACTPROGRAMMINGPROJECT_GROUPBY_H
+#define ABSTRACTPROGRAMMINGPROJECT_GROUPBY_H
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "column.h"
+
+// Rows are mapped to groups and fed to the accumulators in morsels of this
+// many rows, so the per-row group ids never outgrow a single morsel.
+constexpr size_t GROUPBY_MORSEL_SIZE = 16384;
+// A parallel groupBy merges its thread-local tables in radix partitions
+// once they hold at least this many groups in total.
+constexpr size_t GROUPBY_PARTITION_MIN_GROUPS = 1 << 16;
+constexpr uint32_t NULL_GROUP = std::numeric_limits<uint32_t>::max();
+
+enum class AggregationOp {
+    Sum,
+    Count,
+    Mean,
+    Min,
+    Max,
+    ApproxCountDistinct
+};
+
+AggregationOp parseAggregation(const std::string& name);
+std::string aggregationName(AggregationOp op);
+
+// Maps the values of one key column to dense ids in order of first
+// appearance. Null keys get NULL_GROUP. Every id remembers the first row it
+// was seen at, which is enough to materialize the key value later.
+class KeyEncoder {
+private:
+    const ColumnBuffer* buffer;
+    std::unordered_map<int, uint32_t> intIds;
+    std::unordered_map<uint64_t, uint32_t> doubleIds;
+    std::unordered_map<std::string_view, uint32_t> stringIds;
+    std::vector<uint32_t> codeIds;
+    std::vector<size_t> firstRows;
+
+    uint32_t newId(size_t row);
+
+public:
+    explicit KeyEncoder(const ColumnBuffer& buffer);
+
+    uint32_t encodeRow(size_t row);
+    void encode(size_t begin, size_t end, std::vector<uint32_t>& ids);
+    size_t cardinality() const { return this->firstRows.size(); }
+    const std::vector<size_t>& getFirstRows() const { return this->firstRows; }
+    ColumnKind kind() const { return this->buffer->kind(); }
+
+    // Id of a value that was already encoded, NULL_GROUP if it never was
+    uint32_t lookup(int value) const;
+    uint32_t lookup(double value) const;
+    uint32_t lookup(bool value) const;
+    uint32_t lookup(std::string_view value) const;
+};
+
+// Combines the per-column ids of a composite key into one dense group id.
+// Every extra key column folds the id so far and its own id into a pair
+// table, a row with a null in any key column belongs to no group.
+class GroupKeyEncoder {
+private:
+    std::vector<KeyEncoder> columns;
+    std::vector<std::unordered_map<uint64_t, uint32_t>> pairIds;
+    std::vector<size_t> firstRows;
+    std::vector<uint32_t> columnIds;
+
+    static uint64_t pairKey(uint32_t left, uint32_t right) { return (static_cast<uint64_t>(left) << 32) | right; }
+
+public:
+    explicit GroupKeyEncoder(const std::vector<const ColumnBuffer*>& buffers);
+
+    uint32_t encodeRow(size_t row);
+    void encode(size_t begin, size_t end, std::vector<uint32_t>& ids);
+    size_t cardinality() const { return this->getFirstRows().size(); }
+    const std::vector<size_t>& getFirstRows() const;
+
+    size_t width() const { return this->columns.size(); }
+    const KeyEncoder& column(size_t index) const { return this->columns[index]; }
+    // Group id of already encoded per-column ids, NULL_GROUP if the combination never occurred
+    uint32_t lookup(const std::vector<uint32_t>& columnIds) const;
+};
+
+// Running state of one aggregation over one value column, one slot per group.
+// Min and max remember the row of the current extreme instead of a copy of
+// the value, which keeps string columns cheap and partial states mergeable.
+class Aggregator {
+private:
+    AggregationOp op;
+    const ColumnBuffer* buffer;
+    std::vector<uint64_t> counts;
+    std::vector<int64_t> intSums;
+    std::vector<double> doubleSums;
+    std::vector<size_t> extremeRows;
+    std::vector<uint32_t> dictionaryRanks;
+    std::vector<DistinctSketch> distinctSketches;
+    std::vector<uint64_t> codeHashes;
+
+    bool isBetter(size_t candidate, size_t current) const;
+
+public:
+    Aggregator(const ColumnBuffer& buffer, AggregationOp op);
+
+    AggregationOp getOp() const { return this->op; }
+    void resize(size_t numberOfGroups);
+    void update(const std::vector<uint32_t>& groupIds, size_t begin, size_t end);
+    void merge(const Aggregator& other, const std::vector<uint32_t>& otherGroups, const std::vector<uint32_t>& targetGroups);
+    ColumnBuffer finalize(const std::vector<uint32_t>& groupOrder) const;
+};
+
+// Single pass hash aggregation: rows go through the key encoder morsel by
+// morsel and every aggregator updates its per-group state straight from the
+// typed column buffers. Memory grows with the number of groups only.
+//
+// consumeParallel() lets every worker aggregate whole morsels into its own
+// thread-local table. The partial tables are merged afterwards, split into
+// radix partitions by key hash when there are many groups so that every
+// partition merges on its own thread. Integer sums, counts, min and max are
+// exact, so they match the serial result regardless of the thread count.
+class HashAggregation {
+private:
+    std::vector<const ColumnBuffer*> keyBuffers;
+    std::vector<std::pair<const ColumnBuffer*, AggregationOp>> specs;
+    GroupKeyEncoder keys;
+    std::vector<Aggregator> aggregators;
+    // earliest row holding the key of every group
+    std::vector<size_t> groupRows;
+
+    void mergeLocal(std::vector<HashAggregation>& locals, size_t threads);
+
+public:
+    HashAggregation(const std::vector<const ColumnBuffer*>& keyBuffers, const std::vector<std::pair<const ColumnBuffer*, AggregationOp>>& specs);
+
+    void consume(size_t begin, size_t end);
+    void consumeParallel(size_t begin, size_t end, size_t threads);
+    size_t numberOfGroups() const { return this->groupRows.size(); }
+    std::vector<uint32_t> groupOrder(bool sorted) const;
+    ColumnBuffer keyColumn(size_t keyIndex, const std::vector<uint32_t>& groupOrder) const;
+    ColumnBuffer result(size_t aggregatorIndex, const std::vector<uint32_t>& groupOrder) const;
+};
+
+#endif //ABSTRACTPROGRAMMINGPROJECT_GROUPBY_H
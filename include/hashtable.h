@@ -0,0 +1,91 @@
+#ifndef ABSTRACTPROGRAMMINGPROJECT_HASHTABLE_H
+#define ABSTRACTPROGRAMMINGPROJECT_HASHTABLE_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "sketch.h"
+
+// Open addressing value -> count table with linear probing over flat arrays.
+// Keys are int, double, bool or string_view into the counted buffer, so a
+// string is never copied. Keys hash like the distinct sketch does, which
+// makes 0.0 and -0.0 one key and all NaNs another.
+template<class Key>
+class CountTable {
+private:
+    std::vector<Key> keys;
+    std::vector<size_t> counts;
+    std::vector<uint8_t> used;
+    size_t mask = 0;
+    size_t numberOfKeys = 0;
+
+    static bool equal(const Key& a, const Key& b) {
+        if constexpr (std::is_floating_point_v<Key>) {
+            return a == b || (std::isnan(a) && std::isnan(b));
+        } else {
+            return a == b;
+        }
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Key> oldKeys = std::move(this->keys);
+        std::vector<size_t> oldCounts = std::move(this->counts);
+        std::vector<uint8_t> oldUsed = std::move(this->used);
+        this->keys.assign(capacity, Key());
+        this->counts.assign(capacity, 0);
+        this->used.assign(capacity, 0);
+        this->mask = capacity - 1;
+        this->numberOfKeys = 0;
+        for (size_t slot = 0; slot < oldUsed.size(); ++slot) {
+            if (oldUsed[slot]) {
+                this->add(oldKeys[slot], oldCounts[slot]);
+            }
+        }
+    }
+
+public:
+    explicit CountTable(size_t expectedKeys = 16) {
+        size_t capacity = 16;
+        while (capacity * 7 < expectedKeys * 10) {
+            capacity *= 2;
+        }
+        this->rehash(capacity);
+    }
+
+    size_t size() const { return this->numberOfKeys; }
+
+    void add(const Key& key, size_t times = 1) {
+        size_t slot = DistinctSketch::hashValue(key) & this->mask;
+        while (this->used[slot]) {
+            if (equal(this->keys[slot], key)) {
+                this->counts[slot] += times;
+                return;
+            }
+            slot = (slot + 1) & this->mask;
+        }
+        this->keys[slot] = key;
+        this->counts[slot] = times;
+        this->used[slot] = 1;
+        // keep the load below 70% so probe sequences stay short
+        if (++this->numberOfKeys * 10 > this->keys.size() * 7) {
+            this->rehash(this->keys.size() * 2);
+        }
+    }
+
+    void merge(const CountTable& other) {
+        other.forEach([this](const Key& key, size_t count) {
+            this->add(key, count);
+        });
+    }
+
+    // Visits every key with its count in table order
+    template<class Visitor> void forEach(Visitor&& visitor) const {
+        for (size_t slot = 0; slot < this->used.size(); ++slot) {
+            if (this->used[slot]) {
+                visitor(this->keys[slot], this->counts[slot]);
+            }
+        }
+    }
+};
+
+#endif //ABSTRACTPROGRAMMINGPROJECT_HASHTABLE_H
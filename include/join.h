@@ -0,0 +1,91 @@
+#ifndef ABSTRACTPROGRAMMINGPROJECT_JOIN_H
+#define ABSTRACTPROGRAMMINGPROJECT_JOIN_H
+
+#include <string>
+#include <vector>
+#include "groupby.h"
+#include "sort.h"
+
+enum class JoinType {
+    Inner,
+    Left,
+    Semi,
+    Anti
+};
+
+JoinType parseJoinType(const std::string& how);
+
+// Matching rows of a join, the i-th output row combines leftRows[i] with
+// rightRows[i]. NO_ROW on the right marks a left row without a match, semi
+// and anti joins only fill leftRows.
+struct JoinIndices {
+    std::vector<size_t> leftRows;
+    std::vector<size_t> rightRows;
+};
+
+// Hash table over the key columns of the build side of a join. Build rows
+// are stored grouped by key id in one array, so the rows matching a key are
+// a contiguous range in build order. Null keys are never inserted.
+class JoinHashTable {
+private:
+    GroupKeyEncoder keys;
+    std::vector<uint32_t> rowGroups;
+    std::vector<size_t> groupStarts;
+    std::vector<size_t> rows;
+
+public:
+    explicit JoinHashTable(const std::vector<const ColumnBuffer*>& buildKeys);
+
+    const GroupKeyEncoder& getKeys() const { return this->keys; }
+    size_t numberOfGroups() const { return this->keys.cardinality(); }
+    uint32_t groupOfRow(size_t row) const { return this->rowGroups[row]; }
+    const size_t* rowsBegin(uint32_t group) const { return this->rows.data() + this->groupStarts[group]; }
+    const size_t* rowsEnd(uint32_t group) const { return this->rows.data() + this->groupStarts[group + 1]; }
+};
+
+// Resolves rows of the probe side to key ids of a build side encoder without
+// inserting anything. Dictionary probe columns are translated once per
+// distinct value instead of once per row.
+class KeyProbe {
+private:
+    const GroupKeyEncoder* keys;
+    std::vector<const ColumnBuffer*> probeKeys;
+    std::vector<std::vector<uint32_t>> dictionaryIds;
+
+public:
+    KeyProbe(const GroupKeyEncoder& keys, const std::vector<const ColumnBuffer*>& probeKeys);
+
+    // columnIds is scratch space, so concurrent callers do not share state
+    uint32_t find(size_t row, std::vector<uint32_t>& columnIds) const;
+};
+
+// Builds the hash table on the smaller side, probes it with the larger one
+// morsel by morsel on up to `threads` workers and returns the matching rows
+// in left row order.
+JoinIndices hashJoin(const std::vector<const ColumnBuffer*>& leftKeys,
+                     const std::vector<const ColumnBuffer*>& rightKeys,
+                     JoinType type,
+                     size_t threads);
+
+// Single pass merge of two inputs in ascending key order, as given by the
+// row orders (an empty order means the rows already are in key order).
+// Matches come out in the sorted order of the left side.
+JoinIndices mergeJoin(const std::vector<const ColumnBuffer*>& leftKeys,
+                      const std::vector<const ColumnBuffer*>& rightKeys,
+                      JoinType type,
+                      const std::vector<size_t>& leftOrder,
+                      const std::vector<size_t>& rightOrder);
+
+// For every left row the last right row with the same `by` keys whose `on`
+// value is not greater than the left one and at most `tolerance` behind it,
+// NO_ROW if there is none. Both orders must sort their side by the `by` keys
+// first and by `on` last.
+std::vector<size_t> asofMatches(const ColumnBuffer& leftOn,
+                                const ColumnBuffer& rightOn,
+                                const std::vector<const ColumnBuffer*>& leftBy,
+                                const std::vector<const ColumnBuffer*>& rightBy,
+                                std::optional<double> tolerance,
+                                const std::vector<size_t>& leftOrder,
+                                const std::vector<size_t>& rightOrder);
+
+#endif //ABSTRACTPROGRAMMINGPROJECT_JOIN_H
@@ -0,0 +1,49 @@
+#ifndef ABSTRACTPROGRAMMINGPROJECT_PARALLEL_H
+#define ABSTRACTPROGRAMMINGPROJECT_PARALLEL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of hardware threads, at least one
+size_t hardwareThreads();
+
+// Fixed set of worker threads shared by all parallel kernels. A parallelFor
+// caller always works on its own tasks too, so nested or concurrent calls
+// make progress even when every worker is busy.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    void submit(std::function<void()> job);
+
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return this->workers.size() + 1; }
+
+    // Runs body(task, worker) for every task in [0, numberOfTasks) on up to
+    // maxWorkers threads including the caller. Tasks are handed out one at a
+    // time in increasing order, so a worker sees its tasks sorted. The first
+    // exception thrown by a task is rethrown on the calling thread.
+    void parallelFor(size_t numberOfTasks, size_t maxWorkers, const std::function<void(size_t task, size_t worker)>& body);
+};
+
+// The pool behind parallelFor, sized to the hardware threads until resized
+ThreadPool& sharedThreadPool();
+void setThreadPoolSize(size_t threads);
+
+void parallelFor(size_t numberOfTasks, size_t threads, const std::function<void(size_t task, size_t worker)>& body);
+
+#endif //ABSTRACTPROGRAMMINGPROJECT_PARALLEL_H
@@ -0,0 +1,109 @@
+#ifndef ABSTRACTPROGRAMMINGPROJECT_PREDICATE_H
+#define ABSTRACTPROGRAMMINGPROJECT_PREDICATE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include "buffer.h"
+
+class DataFrame;
+
+// Conditions are evaluated in ranges of this many rows per task, small
+// enough for the intermediate masks of a range to stay in cache
+constexpr size_t PREDICATE_RANGE_SIZE = 1 << 16;
+
+enum class CompareOp {
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual
+};
+
+// Row condition over the columns of a DataFrame, built from col() and the
+// comparison and logical operators:
+//
+//     df.filter(col("latency") > 200 && col("status") == "ok")
+//
+// Evaluation never looks at a row on its own. Every comparison runs a typed
+// loop over a column that packs 64 results into a mask word, && || and !
+// combine whole words. Numbers compare with numbers and strings with strings,
+// other pairings throw TypeMismatchException. A comparison is false on a null
+// row, isNull() selects those.
+class Condition {
+private:
+    struct Node;
+    std::shared_ptr<const Node> node;
+
+    explicit Condition(std::shared_ptr<const Node> node) : node(std::move(node)) {}
+    static const ColumnBuffer& bufferOf(const DataFrame& frame, const std::string& name);
+    static void checkColumns(const Node& node, const DataFrame& frame);
+    static void evaluateRange(const Node& node, const DataFrame& frame, size_t rows, size_t beginWord, size_t endWord, uint64_t* out);
+
+    friend class ColumnReference;
+    friend Condition operator&&(const Condition& lhs, const Condition& rhs);
+    friend Condition operator||(const Condition& lhs, const Condition& rhs);
+    friend Condition operator!(const Condition& condition);
+
+public:
+    // One bit per row of the frame, 0 threads means one per hardware thread
+    Bitmask evaluate(const DataFrame& frame, size_t threads = 1) const;
+};
+
+Condition operator&&(const Condition& lhs, const Condition& rhs);
+Condition operator||(const Condition& lhs, const Condition& rhs);
+Condition operator!(const Condition& condition);
+
+// Column named in a Condition, resolved when the condition is evaluated
+class ColumnReference {
+private:
+    std::string name;
+
+    Condition compare(CompareOp op, const ColumnType& value) const;
+    Condition compare(CompareOp op, const ColumnReference& other) const;
+
+    template<class T>
+    static ColumnType literal(const T& value) {
+        if constexpr (std::is_same_v<T, ColumnType> || std::is_same_v<T, bool> || std::is_same_v<T, std::string>) {
+            return value;
+        } else if constexpr (std::is_integral_v<T>) {
+            return static_cast<int>(value);
+        } else if constexpr (std::is_floating_point_v<T>) {
+            return static_cast<double>(value);
+        } else {
+            // string literals and string views
+            return std::string(value);
+        }
+    }
+
+public:
+    explicit ColumnReference(std::string name) : name(std::move(name)) {}
+
+    const std::string& getName() const { return this->name; }
+
+    // Literals are ints, doubles, bools or strings, other arithmetic types are
+    // widened to int or double
+    template<class T> Condition operator==(const T& value) const { return this->compare(CompareOp::Equal, literal(value)); }
+    template<class T> Condition operator!=(const T& value) const { return this->compare(CompareOp::NotEqual, literal(value)); }
+    template<class T> Condition operator<(const T& value) const { return this->compare(CompareOp::Less, literal(value)); }
+    template<class T> Condition operator<=(const T& value) const { return this->compare(CompareOp::LessEqual, literal(value)); }
+    template<class T> Condition operator>(const T& value) const { return this->compare(CompareOp::Greater, literal(value)); }
+    template<class T> Condition operator>=(const T& value) const { return this->compare(CompareOp::GreaterEqual, literal(value)); }
+    // Row by row comparison of two columns of the same frame
+    Condition operator==(const ColumnReference& other) const { return this->compare(CompareOp::Equal, other); }
+    Condition operator!=(const ColumnReference& other) const { return this->compare(CompareOp::NotEqual, other); }
+    Condition operator<(const ColumnReference& other) const { return this->compare(CompareOp::Less, other); }
+    Condition operator<=(const ColumnReference& other) const { return this->compare(CompareOp::LessEqual, other); }
+    Condition operator>(const ColumnReference& other) const { return this->compare(CompareOp::Greater, other); }
+    Condition operator>=(const ColumnReference& other) const { return this->compare(CompareOp::GreaterEqual, other); }
+
+    Condition isNull() const;
+    Condition notNull() const;
+};
+
+ColumnReference col(const std::string& name);
+
+#endif //ABSTRACTPROGRAMMINGPROJECT_PREDICATE_H
@@ -0,0 +1,54 @@
+#ifndef ABSTRACTPROGRAMMINGPROJECT_SIMD_H
+#define ABSTRACTPROGRAMMINGPROJECT_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+template<class T>
+struct MinMax {
+    T min;
+    T max;
+    // false when the range holds no valid slot, min and max are then meaningless
+    bool found;
+};
+
+// Reductions over the valid slots in [begin, end) of a typed buffer, where
+// validity is the word array of its ValidityBitmap. Ranges may start and end
+// anywhere, whole 64 row words in between go through the vector loop.
+//
+// Every kernel exists as a scalar loop and, on x86, as an AVX2 version built
+// with a target attribute. numericKernels() picks the AVX2 set once when the
+// CPU reports support for it, so the binary still runs on older machines.
+// NaNs never become a minimum or maximum.
+struct NumericKernels {
+    const char* name;
+    size_t (*countValid)(const uint64_t* validity, size_t begin, size_t end);
+    double (*sumDouble)(const double* data, const uint64_t* validity, size_t begin, size_t end);
+    int64_t (*sumInt)(const int* data, const uint64_t* validity, size_t begin, size_t end);
+    // sum of (x - mean)^2 over the valid slots
+    double (*squaredDeviationsDouble)(const double* data, const uint64_t* validity, size_t begin, size_t end, double mean);
+    double (*squaredDeviationsInt)(const int* data, const uint64_t* validity, size_t begin, size_t end, double mean);
+    MinMax<double> (*minMaxDouble)(const double* data, const uint64_t* validity, size_t begin, size_t end);
+    MinMax<int> (*minMaxInt)(const int* data, const uint64_t* validity, size_t begin, size_t end);
+};
+
+const NumericKernels& scalarKernels();
+// nullptr when the build or the CPU has no AVX2
+const NumericKernels* avx2Kernels();
+// The fastest set this CPU supports
+const NumericKernels& numericKernels();
+
+// Typed front ends dispatching through numericKernels()
+inline size_t countValid(const uint64_t* validity, size_t begin, size_t end) { return numericKernels().countValid(validity, begin, end); }
+inline double sumValid(const double* data, const uint64_t* validity, size_t begin, size_t end) { return numericKernels().sumDouble(data, validity, begin, end); }
+inline int64_t sumValid(const int* data, const uint64_t* validity, size_t begin, size_t end) { return numericKernels().sumInt(data, validity, begin, end); }
+inline double squaredDeviations(const double* data, const uint64_t* validity, size_t begin, size_t end, double mean) {
+    return numericKernels().squaredDeviationsDouble(data, validity, begin, end, mean);
+}
+inline double squaredDeviations(const int* data, const uint64_t* validity, size_t begin, size_t end, double mean) {
+    return numericKernels().squaredDeviationsInt(data, validity, begin, end, mean);
+}
+inline MinMax<double> minMaxValid(const double* data, const uint64_t* validity, size_t begin, size_t end) { return numericKernels().minMaxDouble(data, validity, begin, end); }
+inline MinMax<int> minMaxValid(const int* data, const uint64_t* validity, size_t begin, size_t end) { return numericKernels().minMaxInt(data, validity, begin, end); }
+
+#endif //ABSTRACTPROGRAMMINGPROJECT_SIMD_H
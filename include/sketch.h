@@ -0,0 +1,102 @@
+#ifndef ABSTRACTPROGRAMMINGPROJECT_SKETCH_H
+#define ABSTRACTPROGRAMMINGPROJECT_SKETCH_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "buffer.h"
+
+// HyperLogLog precision, 2^p registers with a relative error of 1.04 / sqrt(2^p)
+constexpr unsigned DISTINCT_SKETCH_DEFAULT_PRECISION = 14;
+// Per-group sketches of a groupBy stay smaller, about 1.6% error
+constexpr unsigned DISTINCT_SKETCH_GROUP_PRECISION = 12;
+
+// Compactor size used when no accuracy is requested, about 1.3% rank error
+constexpr size_t QUANTILE_SKETCH_DEFAULT_K = 200;
+
+// Mergeable KLL quantile sketch over doubles. Values land in level 0; a full
+// level is sorted and every other value moves up one level with twice the
+// weight, starting at a random offset. Upper levels get capacity k and each
+// level below two thirds of the one above, so the sketch keeps O(k) values
+// however many it has seen.
+//
+// Error bound: with probability 99% the rank of quantile(p) differs from
+// p * size() by at most normalizedRankError() * size(), where the error is
+// about 2.3 / k. The sketch is built for one column and then fed the rows
+// appended since the last update(buffer, begin, end); sketches of separate
+// partitions or threads combine with merge() under the same bound.
+class QuantileSketch {
+private:
+    size_t k;
+    std::vector<std::vector<double>> levels;
+    uint64_t count = 0;
+    size_t retainedItems = 0;
+    size_t budget = 0;
+    double minValue = 0.0;
+    double maxValue = 0.0;
+    uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+
+    size_t capacity(size_t level) const;
+    void addLevel();
+    bool nextBit();
+    void compress();
+
+public:
+    explicit QuantileSketch(size_t k = QUANTILE_SKETCH_DEFAULT_K);
+    // Smallest sketch whose normalized rank error stays below accuracy
+    static QuantileSketch withAccuracy(double accuracy);
+
+    size_t getK() const { return this->k; }
+    uint64_t size() const { return this->count; }
+    bool isEmpty() const { return this->count == 0; }
+    double normalizedRankError() const;
+
+    void update(double value);
+    // Adds the valid numeric cells in [begin, end), other kinds add nothing
+    void update(const ColumnBuffer& buffer, size_t begin, size_t end);
+    void merge(const QuantileSketch& other);
+    // Value whose rank is about p * size(), exact at p = 0 and p = 1
+    double quantile(double p) const;
+};
+
+// HyperLogLog distinct counter. Every value is hashed to 64 bits, the top p
+// bits pick a register and the register keeps the longest run of leading
+// zeros seen in the remaining bits. Equal values always hash equal, so the
+// sketches of chunks, threads or groups merge by taking register maxima.
+//
+// Sketches start sparse as a list of (register, rank) entries and switch to
+// the dense register array once that list would be the larger one, which
+// keeps per-group sketches of small groups down to a few bytes.
+class DistinctSketch {
+private:
+    unsigned precision;
+    std::vector<uint8_t> registers;
+    // register << 8 | rank, sorted and unique up to sparseSorted
+    std::vector<uint32_t> sparse;
+    size_t sparseSorted = 0;
+
+    size_t numberOfRegisters() const { return size_t(1) << this->precision; }
+    void compactSparse();
+    void toDense();
+
+public:
+    explicit DistinctSketch(unsigned precision = DISTINCT_SKETCH_DEFAULT_PRECISION);
+
+    static uint64_t hashValue(int value);
+    static uint64_t hashValue(double value);
+    static uint64_t hashValue(bool value);
+    static uint64_t hashValue(std::string_view value);
+    // Hash of every dictionary entry, cells hash through their code
+    static std::vector<uint64_t> codeHashes(const DictionaryArray& dictionary);
+
+    unsigned getPrecision() const { return this->precision; }
+    double relativeError() const;
+
+    void addHash(uint64_t hash);
+    // Adds the valid cells in [begin, end)
+    void update(const ColumnBuffer& buffer, size_t begin, size_t end);
+    void merge(const DistinctSketch& other);
+    double estimate() const;
+};
+
+#endif //ABSTRACTPROGRAMMINGPROJECT_SKETCH_H
@@ -0,0 +1,71 @@
+#ifndef ABSTRACTPROGRAMMINGPROJECT_SORT_H
+#define ABSTRACTPROGRAMMINGPROJECT_SORT_H
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+#include "buffer.h"
+
+// Rows are normalized and packed in ranges of this many rows per task
+constexpr size_t SORT_RANGE_SIZE = 1 << 16;
+// Parallel sorts split smaller inputs no further than a serial radix sort
+constexpr size_t SORT_PARALLEL_MIN_ROWS = 1 << 18;
+// Sample sort buckets per thread and sampled keys per bucket
+constexpr size_t SORT_BUCKETS_PER_THREAD = 4;
+constexpr size_t SORT_OVERSAMPLING = 32;
+
+// Three-way comparison of cell i of a with cell j of b. Numbers compare with
+// numbers and strings with strings, whatever their physical encoding. Nulls
+// compare equal to each other and greater than any value.
+int compareCells(const ColumnBuffer& a, size_t i, const ColumnBuffer& b, size_t j);
+
+// Lexicographic comparison of two rows over matching lists of key columns
+int compareRows(const std::vector<const ColumnBuffer*>& a, size_t i, const std::vector<const ColumnBuffer*>& b, size_t j);
+
+bool hasNullKey(const std::vector<const ColumnBuffer*>& keys, size_t row);
+
+// Row order that sorts the key columns, ties keep their original order. Nulls
+// go before or after all values of their column whatever the direction.
+//
+// Every key column is turned into normalized keys, unsigned integers that
+// compare like the values: ints and doubles by flipping sign bits, bools as
+// is, dictionary columns through the rank of each code and plain strings
+// through a dense rank computed by one typed string sort. The permutation is
+// then built by stable radix sorts from the last key column to the first,
+// packing neighbouring columns into one 64 bit key where they fit. With more
+// than one thread every round is a parallel sample sort.
+std::vector<size_t> sortPermutation(const std::vector<const ColumnBuffer*>& keys, const std::vector<bool>& ascending,
+                                    bool nullsFirst = false, size_t threads = 1);
+bool isSorted(const std::vector<const ColumnBuffer*>& keys, const std::vector<bool>& ascending, bool nullsFirst = false);
+
+// Moves the order statistics at the given ranks into place, values[r] ends up
+// holding what a full sort would put there. Every nth_element call splits the
+// remaining ranks in half, so q ranks cost O(n log q) instead of a sort.
+// Takes iterators rather than pointers so std::vector<bool> works as well.
+template<class Iterator>
+void selectRanks(Iterator first, Iterator last, size_t offset, const size_t* ranksBegin, const size_t* ranksEnd) {
+    while (ranksBegin != ranksEnd && first != last) {
+        const size_t* middle = ranksBegin + (ranksEnd - ranksBegin) / 2;
+        Iterator nth = first + static_cast<std::ptrdiff_t>(*middle - offset);
+        std::nth_element(first, nth, last);
+        selectRanks(first, nth, offset, ranksBegin, middle);
+        first = nth + 1;
+        offset = *middle + 1;
+        ranksBegin = middle + 1;
+    }
+}
+
+template<class T>
+void selectRanks(std::vector<T>& values, std::vector<size_t> ranks) {
+    std::sort(ranks.begin(), ranks.end());
+    ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+    selectRanks(values.begin(), values.end(), 0, ranks.data(), ranks.data() + ranks.size());
+}
+
+// Rows holding the k largest (or smallest) key tuples, best first. Rows with
+// a null key are skipped and ties go to the earlier row. Every thread keeps a
+// bounded heap of k rows over its own range and the heaps are merged at the
+// end, so the cost is O(n log k) and the memory O(k) per thread.
+std::vector<size_t> topRows(const std::vector<const ColumnBuffer*>& keys, size_t k, bool largest, size_t threads = 1);
+
+#endif //ABSTRACTPROGRAMMINGPROJECT_SORT_H
@@ -0,0 +1,95 @@
+#ifndef ABSTRACTPROGRAMMINGPROJECT_VIEW_H
+#define ABSTRACTPROGRAMMINGPROJECT_VIEW_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "column.h"
+
+class DataFrame;
+class GroupBy;
+class RowRange;
+
+// Read-only window of rows [offset, offset + length) on a column buffer. The
+// buffer is shared, not copied, so taking or slicing a ColumnSlice is O(1)
+// and the slice stays valid and unchanged whatever happens to the column it
+// came from: the column copies a shared buffer before changing it.
+class ColumnSlice {
+private:
+    std::string name;
+    std::shared_ptr<const ColumnBuffer> buffer;
+    size_t offset = 0;
+    size_t length = 0;
+
+public:
+    ColumnSlice(std::string name, std::shared_ptr<const ColumnBuffer> buffer, size_t offset, size_t length);
+
+    const std::string& getName() const { return this->name; }
+    size_t size() const { return this->length; }
+    bool isEmpty() const { return this->length == 0; }
+    size_t getOffset() const { return this->offset; }
+    const ColumnBuffer& getBuffer() const { return *this->buffer; }
+
+    bool isNull(size_t index) const;
+    std::optional<ColumnType> operator[](size_t index) const;
+    size_t countNull() const;
+    size_t countNonNull() const { return this->length - this->countNull(); }
+    // Extremes are rows of the slice
+    ColumnStats stats(size_t threads = 1) const;
+
+    // Rows [offset, offset + length) of this slice, the length is cut at the end
+    ColumnSlice slice(size_t offset, size_t length) const;
+    ColumnSlice head(size_t n = 5) const;
+    ColumnSlice tail(size_t n = 5) const;
+
+    // Owning column, shares the buffer when the slice covers all of it
+    Column<ColumnType> toColumn() const;
+};
+
+// Read-only window on a DataFrame: a subset of its columns and a range of
+// its rows. Projections and row ranges only copy shared buffer pointers, so
+// head, tail, slice and select are O(1) per column, and reading through a
+// view costs the same as reading the frame.
+class DataFrameView {
+private:
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<const ColumnBuffer>> buffers;
+    size_t offset = 0;
+    size_t length = 0;
+
+    size_t position(const std::string& columnName) const;
+
+    friend class GroupBy;
+
+public:
+    DataFrameView() = default;
+    DataFrameView(std::vector<std::string> names, std::vector<std::shared_ptr<const ColumnBuffer>> buffers, size_t offset, size_t length);
+
+    size_t numberOfRows() const { return this->length; }
+    size_t numberOfColumns() const { return this->names.size(); }
+    std::pair<size_t, size_t> shape() const { return {this->names.size(), this->length}; }
+    bool isEmpty() const { return this->length == 0 || this->names.empty(); }
+    const std::vector<std::string>& columnNames() const { return this->names; }
+
+    ColumnSlice column(const std::string& columnName) const;
+    ColumnSlice column(size_t index) const;
+
+    DataFrameView slice(size_t offset, size_t length) const;
+    DataFrameView head(size_t n = 5) const;
+    DataFrameView tail(size_t n = 5) const;
+    DataFrameView select(const std::vector<std::string>& columnNames) const;
+
+    // Rows of the view, valid as long as the view is
+    RowRange rows() const;
+    void print() const;
+    void saveCSV(const std::string& filePath, const std::string& separator = ",", bool saveHeaderLine = true) const;
+    std::map<std::string, std::map<std::string, ColumnType>> aggregate(const std::vector<std::string>& operations) const;
+    std::map<std::string, std::map<std::string, ColumnType>> describe() const;
+    GroupBy groupBy(const std::vector<std::string>& keys, bool sortGroups = true) const;
+
+    // Owning frame, columns covering a whole buffer share it instead of copying
+    DataFrame toDataFrame() const;
+};
+
+#endif //ABSTRACTPROGRAMMINGPROJECT_VIEW_H
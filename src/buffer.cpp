@@ -0,0 +1,620 @@
+#include "../include/buffer.h"
+#include "../include/parallel.h"
+#include <algorithm>
+#include <bit>
+
+ColumnKind kindOf(const ColumnType& value) {
+    return std::visit([](const auto& v) {
+        return kindOf<std::decay_t<decltype(v)>>();
+    }, value);
+}
+
+std::string kindName(ColumnKind kind) {
+    switch (kind) {
+        case ColumnKind::Int: return "int";
+        case ColumnKind::Double: return "double";
+        case ColumnKind::Bool: return "bool";
+        case ColumnKind::String: return "string";
+        case ColumnKind::Dictionary: return "dictionary";
+        default: return "untyped";
+    }
+}
+
+bool isStringKind(ColumnKind kind) {
+    return kind == ColumnKind::String || kind == ColumnKind::Dictionary;
+}
+
+// VALIDITY BITMAP
+
+ValidityBitmap::ValidityBitmap(size_t n, bool valid) {
+    this->resize(n, valid);
+}
+
+ValidityBitmap::ValidityBitmap(std::vector<uint64_t> words, size_t n) : words(std::move(words)), length(n) {
+    this->words.resize((n + 63) >> 6, 0);
+    if (n & 63) {
+        this->words.back() &= (1ULL << (n & 63)) - 1;
+    }
+}
+
+void ValidityBitmap::set(size_t index, bool valid) {
+    uint64_t mask = 1ULL << (index & 63);
+    if (valid) {
+        this->words[index >> 6] |= mask;
+    } else {
+        this->words[index >> 6] &= ~mask;
+    }
+}
+
+void ValidityBitmap::append(bool valid) {
+    if ((this->length & 63) == 0) {
+        this->words.push_back(0);
+    }
+    this->length++;
+    if (valid) {
+        this->set(this->length - 1, true);
+    }
+}
+
+void ValidityBitmap::insert(size_t index, bool valid) {
+    this->append(false);
+    for (size_t i = this->length - 1; i > index; i--) {
+        this->set(i, this->get(i - 1));
+    }
+    this->set(index, valid);
+}
+
+void ValidityBitmap::erase(size_t index) {
+    for (size_t i = index; i + 1 < this->length; i++) {
+        this->set(i, this->get(i + 1));
+    }
+    this->set(this->length - 1, false);
+    this->length--;
+    this->words.resize((this->length + 63) / 64);
+}
+
+void ValidityBitmap::resize(size_t n, bool valid) {
+    size_t oldLength = this->length;
+    this->words.resize((n + 63) / 64, 0);
+    this->length = n;
+    if (n > oldLength && valid) {
+        for (size_t i = oldLength; i < n && (i & 63) != 0; i++) {
+            this->set(i, true);
+        }
+        for (size_t w = (oldLength + 63) / 64; w < this->words.size(); w++) {
+            this->words[w] = ~0ULL;
+        }
+    }
+    if ((n & 63) != 0) {
+        this->words.back() &= (1ULL << (n & 63)) - 1;
+    }
+}
+
+void ValidityBitmap::reserve(size_t n) {
+    this->words.reserve((n + 63) / 64);
+}
+
+void ValidityBitmap::clear() {
+    this->words.clear();
+    this->length = 0;
+}
+
+size_t ValidityBitmap::countValid() const {
+    size_t count = 0;
+    for (uint64_t word : this->words) {
+        count += std::popcount(word);
+    }
+    return count;
+}
+
+void ValidityBitmap::intersect(const ValidityBitmap& other) {
+    if (other.size() != this->length) {
+        throw InvalidSizeException();
+    }
+    for (size_t w = 0; w < this->words.size(); w++) {
+        this->words[w] &= other.words[w];
+    }
+}
+
+// DICTIONARY ARRAY
+
+DictionaryArray::DictionaryArray(size_t n) {
+    this->codes.assign(n, n > 0 ? this->encode(std::string()) : 0);
+}
+
+DictionaryArray::DictionaryArray(const std::vector<std::string>& values) {
+    this->codes.reserve(values.size());
+    for (const auto& value : values) {
+        this->push_back(value);
+    }
+}
+
+uint32_t DictionaryArray::encode(const std::string& value) {
+    std::optional<uint32_t> existing = this->codeOf(value);
+    if (existing.has_value()) {
+        return *existing;
+    }
+    Entries& entries = this->writeEntries();
+    uint32_t code = static_cast<uint32_t>(entries.dictionary.size());
+    entries.dictionary.push_back(value);
+    entries.lookup.emplace(value, code);
+    return code;
+}
+
+std::optional<uint32_t> DictionaryArray::codeOf(const std::string& value) const {
+    auto it = this->entries->lookup.find(value);
+    if (it == this->entries->lookup.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void DictionaryArray::insertAt(size_t index, const std::string& value) {
+    this->codes.insert(this->codes.begin() + index, this->encode(value));
+}
+
+void DictionaryArray::eraseAt(size_t index) {
+    this->codes.erase(this->codes.begin() + index);
+}
+
+void DictionaryArray::recode(uint32_t from, uint32_t to, const ValidityBitmap& validity) {
+    for (size_t i = 0; i < this->codes.size(); i++) {
+        if (this->codes[i] == from && validity.get(i)) {
+            this->codes[i] = to;
+        }
+    }
+}
+
+std::vector<std::string> DictionaryArray::decode() const {
+    std::vector<std::string> values;
+    values.reserve(this->codes.size());
+    for (uint32_t code : this->codes) {
+        values.push_back(this->entries->dictionary[code]);
+    }
+    return values;
+}
+
+DictionaryArray DictionaryArray::sharingEntries() const {
+    DictionaryArray result;
+    result.entries = this->entries;
+    return result;
+}
+
+DictionaryArray DictionaryArray::slice(size_t offset, size_t length) const {
+    DictionaryArray result = this->sharingEntries();
+    result.codes.assign(this->codes.begin() + static_cast<std::ptrdiff_t>(offset), this->codes.begin() + static_cast<std::ptrdiff_t>(offset + length));
+    return result;
+}
+
+// Null rows get the code of the empty string
+DictionaryArray DictionaryArray::gather(const std::vector<size_t>& indices) const {
+    DictionaryArray result = this->sharingEntries();
+    result.codes.resize(indices.size());
+    uint32_t nullCode = 0;
+    bool hasNullCode = false;
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (indices[i] != NO_ROW) {
+            result.codes[i] = this->codes[indices[i]];
+            continue;
+        }
+        if (!hasNullCode) {
+            nullCode = result.encode(std::string());
+            hasNullCode = true;
+        }
+        result.codes[i] = nullCode;
+    }
+    return result;
+}
+
+// MASK RANGES
+
+// Rows selected before each FILTER_RANGE_SIZE range of the mask, plus the
+// total at the end
+static std::vector<size_t> maskRangeOffsets(const Bitmask& mask) {
+    constexpr size_t wordsPerRange = FILTER_RANGE_SIZE / 64;
+    const std::vector<uint64_t>& words = mask.getWords();
+    size_t ranges = (words.size() + wordsPerRange - 1) / wordsPerRange;
+    std::vector<size_t> offsets(ranges + 1, 0);
+    for (size_t range = 0; range < ranges; ++range) {
+        size_t count = 0;
+        for (size_t w = range * wordsPerRange; w < std::min(words.size(), (range + 1) * wordsPerRange); ++w) {
+            count += static_cast<size_t>(std::popcount(words[w]));
+        }
+        offsets[range + 1] = offsets[range] + count;
+    }
+    return offsets;
+}
+
+// Runs body(range, beginWord, endWord) for every range of the mask
+template<class Body>
+static void forEachMaskRange(const Bitmask& mask, size_t threads, Body&& body) {
+    constexpr size_t wordsPerRange = FILTER_RANGE_SIZE / 64;
+    size_t words = mask.getWords().size();
+    parallelFor((words + wordsPerRange - 1) / wordsPerRange, threads, [&](size_t range, size_t) {
+        body(range, range * wordsPerRange, std::min(words, (range + 1) * wordsPerRange));
+    });
+}
+
+// Copies the values of the rows set in mask words [beginWord, endWord) to out,
+// a full word is copied as one block
+template<class T>
+static void compactValues(const T* values, const uint64_t* maskWords, size_t beginWord, size_t endWord, T* out) {
+    for (size_t w = beginWord; w < endWord; ++w) {
+        uint64_t bits = maskWords[w];
+        const T* base = values + (w << 6);
+        if (bits == ~uint64_t(0)) {
+            out = std::copy(base, base + 64, out);
+            continue;
+        }
+        for (; bits != 0; bits &= bits - 1) {
+            *out++ = base[std::countr_zero(bits)];
+        }
+    }
+}
+
+// ORs the low count bits of bits into words starting at bit position
+static void appendBits(uint64_t* words, size_t position, uint64_t bits, size_t count) {
+    size_t shift = position & 63;
+    words[position >> 6] |= bits << shift;
+    if (shift != 0 && shift + count > 64) {
+        words[(position >> 6) + 1] |= bits >> (64 - shift);
+    }
+}
+
+// Packs the bits of source at the rows set in mask words [beginWord, endWord)
+// into out from bit 0, a word at a time
+static void compactBits(const uint64_t* source, const uint64_t* maskWords, size_t beginWord, size_t endWord, uint64_t* out) {
+    size_t position = 0;
+    for (size_t w = beginWord; w < endWord; ++w) {
+        uint64_t bits = maskWords[w];
+        if (bits == 0) {
+            continue;
+        }
+        uint64_t packed = source[w];
+        size_t count = 64;
+        if (bits != ~uint64_t(0)) {
+            packed = 0;
+            count = 0;
+            for (; bits != 0; bits &= bits - 1, ++count) {
+                packed |= ((source[w] >> std::countr_zero(bits)) & 1ULL) << count;
+            }
+        }
+        appendBits(out, position, packed, count);
+        position += count;
+    }
+}
+
+DictionaryArray DictionaryArray::filter(const Bitmask& mask, size_t threads) const {
+    std::vector<size_t> offsets = maskRangeOffsets(mask);
+    DictionaryArray result = this->sharingEntries();
+    result.codes.resize(offsets.back());
+    forEachMaskRange(mask, threads, [&](size_t range, size_t beginWord, size_t endWord) {
+        compactValues(this->codes.data(), mask.getWords().data(), beginWord, endWord, result.codes.data() + offsets[range]);
+    });
+    return result;
+}
+
+// COLUMN BUFFER
+
+ColumnBuffer::ColumnBuffer(ColumnKind kind) {
+    this->fixKind(kind);
+}
+
+void ColumnBuffer::fixKind(ColumnKind kind) {
+    if (this->isTyped()) {
+        if (this->kind() != kind && !(isStringKind(this->kind()) && isStringKind(kind))) {
+            throw TypeMismatchException();
+        }
+        return;
+    }
+    size_t n = this->size();
+    switch (kind) {
+        case ColumnKind::Int: this->data = std::vector<int>(n); break;
+        case ColumnKind::Double: this->data = std::vector<double>(n); break;
+        case ColumnKind::Bool: this->data = std::vector<bool>(n); break;
+        case ColumnKind::String:
+            if (this->autoDictionary) {
+                this->data = DictionaryArray(n);
+            } else {
+                this->data = std::vector<std::string>(n);
+            }
+            break;
+        case ColumnKind::Dictionary: this->data = DictionaryArray(n); break;
+        default: break;
+    }
+}
+
+void ColumnBuffer::checkDictionaryCardinality() {
+    if (!this->autoDictionary || this->kind() != ColumnKind::Dictionary || this->size() < DICTIONARY_MIN_ROWS) {
+        return;
+    }
+    const auto& dictionary = std::get<DictionaryArray>(this->data);
+    if (static_cast<double>(dictionary.cardinality()) > DICTIONARY_MAX_RATIO * static_cast<double>(this->size())) {
+        this->decodeDictionary();
+        this->autoDictionary = false;
+    }
+}
+
+void ColumnBuffer::encodeDictionary() {
+    if (this->kind() == ColumnKind::String) {
+        this->data = DictionaryArray(std::get<std::vector<std::string>>(this->data));
+    }
+}
+
+void ColumnBuffer::decodeDictionary() {
+    if (this->kind() == ColumnKind::Dictionary) {
+        this->data = std::get<DictionaryArray>(this->data).decode();
+    }
+}
+
+std::optional<ColumnType> ColumnBuffer::get(size_t index) const {
+    if (!this->validity.get(index)) {
+        return std::nullopt;
+    }
+    return std::visit([index](const auto& values) -> std::optional<ColumnType> {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (std::is_same_v<Storage, std::monostate>) {
+            return std::nullopt;
+        } else {
+            using T = typename Storage::value_type;
+            return ColumnType(std::in_place_type<T>, values[index]);
+        }
+    }, this->data);
+}
+
+void ColumnBuffer::append(const std::optional<ColumnType>& value) {
+    if (!value.has_value()) {
+        this->appendNull();
+        return;
+    }
+    if (!this->isTyped()) {
+        this->fixKind(kindOf(*value));
+    }
+    std::visit([&value](auto& values) {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            values.push_back(convertValue<typename Storage::value_type>(*value));
+        }
+    }, this->data);
+    this->validity.append(true);
+    if ((this->size() & (DICTIONARY_MIN_ROWS - 1)) == 0) {
+        this->checkDictionaryCardinality();
+    }
+}
+
+void ColumnBuffer::appendNull() {
+    std::visit([](auto& values) {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            values.emplace_back();
+        }
+    }, this->data);
+    this->validity.append(false);
+}
+
+void ColumnBuffer::set(size_t index, const std::optional<ColumnType>& value) {
+    if (index >= this->size()) throw InvalidIndexException();
+    if (value.has_value() && !this->isTyped()) {
+        this->fixKind(kindOf(*value));
+    }
+    std::visit([&value, index](auto& values) {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            using T = typename Storage::value_type;
+            if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+                values.assign(index, value.has_value() ? convertValue<T>(*value) : T());
+            } else {
+                values[index] = value.has_value() ? convertValue<T>(*value) : T();
+            }
+        }
+    }, this->data);
+    this->validity.set(index, value.has_value());
+}
+
+void ColumnBuffer::insert(size_t index, const std::optional<ColumnType>& value) {
+    if (index > this->size()) throw InvalidIndexException();
+    if (value.has_value() && !this->isTyped()) {
+        this->fixKind(kindOf(*value));
+    }
+    std::visit([&value, index](auto& values) {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            using T = typename Storage::value_type;
+            if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+                values.insertAt(index, value.has_value() ? convertValue<T>(*value) : T());
+            } else {
+                values.insert(values.begin() + index, value.has_value() ? convertValue<T>(*value) : T());
+            }
+        }
+    }, this->data);
+    this->validity.insert(index, value.has_value());
+}
+
+void ColumnBuffer::erase(size_t index) {
+    if (index >= this->size()) throw InvalidIndexException();
+    std::visit([index](auto& values) {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+            values.eraseAt(index);
+        } else if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            values.erase(values.begin() + index);
+        }
+    }, this->data);
+    this->validity.erase(index);
+}
+
+void ColumnBuffer::replaceAll(const ColumnType& oldValue, const ColumnType& newValue) {
+    std::visit([&](auto& values) {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+            if (!std::holds_alternative<std::string>(oldValue)) {
+                return;
+            }
+            std::optional<uint32_t> from = values.codeOf(std::get<std::string>(oldValue));
+            if (from.has_value()) {
+                values.recode(*from, values.encode(convertValue<std::string>(newValue)), this->validity);
+            }
+        } else if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            using T = typename Storage::value_type;
+            if (kindOf(oldValue) != kindOf<T>()) {
+                return;
+            }
+            T from = std::get<T>(oldValue);
+            T to = convertValue<T>(newValue);
+            for (size_t i = 0; i < values.size(); i++) {
+                if (values[i] == from && this->validity.get(i)) {
+                    values[i] = to;
+                }
+            }
+        }
+    }, this->data);
+}
+
+void ColumnBuffer::markAllValid() {
+    size_t n = this->size();
+    this->validity.resize(0, false);
+    this->validity.resize(n, true);
+}
+
+void ColumnBuffer::reserve(size_t n) {
+    std::visit([n](auto& values) {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            values.reserve(n);
+        }
+    }, this->data);
+    this->validity.reserve(n);
+}
+
+ColumnBuffer ColumnBuffer::gather(const std::vector<size_t>& indices) const {
+    ValidityBitmap resultValidity(indices.size(), false);
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (indices[i] != NO_ROW && this->validity.get(indices[i])) {
+            resultValidity.set(i, true);
+        }
+    }
+    Storage resultData = std::visit([&indices](const auto& values) -> Storage {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (std::is_same_v<Storage, std::monostate>) {
+            return values;
+        } else if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+            return values.gather(indices);
+        } else {
+            Storage result(indices.size());
+            for (size_t i = 0; i < indices.size(); i++) {
+                if (indices[i] != NO_ROW) {
+                    result[i] = values[indices[i]];
+                }
+            }
+            return result;
+        }
+    }, this->data);
+    ColumnBuffer result(std::move(resultData), std::move(resultValidity));
+    result.autoDictionary = this->autoDictionary;
+    return result;
+}
+
+ColumnBuffer ColumnBuffer::slice(size_t offset, size_t length) const {
+    if (offset + length > this->size()) {
+        throw InvalidIndexException();
+    }
+    ValidityBitmap resultValidity(length, false);
+    for (size_t i = 0; i < length; i++) {
+        if (this->validity.get(offset + i)) {
+            resultValidity.set(i, true);
+        }
+    }
+    Storage resultData = std::visit([offset, length](const auto& values) -> Storage {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (std::is_same_v<Storage, std::monostate>) {
+            return values;
+        } else if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+            return values.slice(offset, length);
+        } else {
+            return Storage(values.begin() + static_cast<std::ptrdiff_t>(offset), values.begin() + static_cast<std::ptrdiff_t>(offset + length));
+        }
+    }, this->data);
+    ColumnBuffer result(std::move(resultData), std::move(resultValidity));
+    result.autoDictionary = this->autoDictionary;
+    return result;
+}
+
+void ColumnBuffer::where(const Bitmask& mask) {
+    if (mask.size() != this->size()) {
+        throw InvalidSizeException();
+    }
+    // only the cells that lose their value are touched, back to the default value nulls hold
+    const std::vector<uint64_t>& valid = this->validity.getWords();
+    const std::vector<uint64_t>& keep = mask.getWords();
+    std::visit([&valid, &keep](auto& values) {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            using T = typename Storage::value_type;
+            for (size_t w = 0; w < valid.size(); w++) {
+                for (uint64_t dropped = valid[w] & ~keep[w]; dropped != 0; dropped &= dropped - 1) {
+                    size_t row = (w << 6) + static_cast<size_t>(std::countr_zero(dropped));
+                    if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+                        values.assign(row, T());
+                    } else {
+                        values[row] = T();
+                    }
+                }
+            }
+        }
+    }, this->data);
+    this->validity.intersect(mask);
+}
+
+ColumnBuffer ColumnBuffer::filter(const Bitmask& mask, size_t threads) const {
+    if (mask.size() != this->size()) {
+        throw InvalidSizeException();
+    }
+    threads = threads == 0 ? hardwareThreads() : threads;
+    std::vector<size_t> offsets = maskRangeOffsets(mask);
+    size_t selected = offsets.back();
+    const uint64_t* maskWords = mask.getWords().data();
+
+    ValidityBitmap resultValidity(selected, true);
+    if (!this->validity.allValid()) {
+        // every range packs its bits from 0, they are shifted into place after
+        std::vector<std::vector<uint64_t>> packed(offsets.size() - 1);
+        forEachMaskRange(mask, threads, [&](size_t range, size_t beginWord, size_t endWord) {
+            packed[range].assign((offsets[range + 1] - offsets[range] + 63) / 64, 0);
+            compactBits(this->validity.getWords().data(), maskWords, beginWord, endWord, packed[range].data());
+        });
+        std::vector<uint64_t> words((selected + 63) / 64, 0);
+        for (size_t range = 0; range < packed.size(); ++range) {
+            size_t count = offsets[range + 1] - offsets[range];
+            for (size_t w = 0; w < packed[range].size(); ++w) {
+                appendBits(words.data(), offsets[range] + (w << 6), packed[range][w], std::min<size_t>(64, count - (w << 6)));
+            }
+        }
+        resultValidity = ValidityBitmap(std::move(words), selected);
+    }
+
+    Storage resultData = std::visit([&](const auto& values) -> Storage {
+        using Storage = std::decay_t<decltype(values)>;
+        if constexpr (std::is_same_v<Storage, std::monostate>) {
+            return values;
+        } else if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+            return values.filter(mask, threads);
+        } else if constexpr (std::is_same_v<Storage, std::vector<bool>>) {
+            // packed bools cannot be written from several threads
+            Storage result(selected);
+            size_t position = 0;
+            mask.forEachSet([&](size_t row) {
+                result[position++] = values[row];
+            });
+            return result;
+        } else {
+            Storage result(selected);
+            forEachMaskRange(mask, threads, [&](size_t range, size_t beginWord, size_t endWord) {
+                compactValues(values.data(), maskWords, beginWord, endWord, result.data() + offsets[range]);
+            });
+            return result;
+        }
+    }, this->data);
+    ColumnBuffer result(std::move(resultData), std::move(resultValidity));
+    result.autoDictionary = this->autoDictionary;
+    return result;
+}
@@ -1,4 +1,7 @@
 #include "../include/column.h"
+#include "../include/sort.h"
+#include "../include/parallel.h"
+#include "../include/simd.h"
 #include <iostream>
 #include <algorithm>
 #include <iomanip>
@@ -8,21 +11,169 @@
 
 using ColumnType = std::variant<int, double, bool, std::string>;
 
+// STORAGE HELPERS
+
+template<class DataType>
+template<class T>
+DataType Column<DataType>::fromStored(const T& value) {
+    if constexpr (std::is_same_v<DataType, ColumnType>) {
+        return ColumnType(std::in_place_type<T>, value);
+    } else if constexpr (std::is_convertible_v<T, DataType>) {
+        return static_cast<DataType>(value);
+    } else {
+        throw std::invalid_argument("Incompatible type in variant.");
+    }
+}
+
+template<class DataType>
+DataType Column<DataType>::fromDouble(double value) requires DecayedOrDirectNumeric<DataType> {
+    if constexpr (std::is_same_v<DataType, ColumnType>) {
+        return ColumnType(value);
+    } else {
+        return static_cast<DataType>(value);
+    }
+}
+
+// Physical representation of a logical value, nullopt if the buffer can never hold it
+template<class DataType>
+template<class T>
+std::optional<T> Column<DataType>::toStored(const DataType& value) {
+    if constexpr (std::is_same_v<DataType, ColumnType>) {
+        if (std::holds_alternative<T>(value)) {
+            return std::get<T>(value);
+        }
+        return std::nullopt;
+    } else if constexpr (std::is_convertible_v<DataType, T>) {
+        return static_cast<T>(value);
+    } else {
+        return std::nullopt;
+    }
+}
+
+// Calls visitor(value, index) for every non-null cell, value has the physical type of the buffer
+template<class DataType>
+template<class Visitor>
+void Column<DataType>::forEachValid(Visitor&& visitor) const {
+    const ValidityBitmap& validity = this->storage->getValidity();
+    this->storage->visit([&](const auto& data) {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            for (size_t i = 0; i < data.size(); i++) {
+                if (validity.get(i)) {
+                    visitor(data[i], i);
+                }
+            }
+        }
+    });
+}
+
+// Non-null numeric cells as doubles; non-numeric kinds contribute nothing
+template<class DataType>
+std::vector<double> Column<DataType>::numericValues() const {
+    std::vector<double> result;
+    this->storage->visit([&](const auto& data) {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            using T = typename Storage::value_type;
+            if constexpr (std::is_arithmetic_v<T>) {
+                const ValidityBitmap& validity = this->storage->getValidity();
+                result.reserve(validity.countValid());
+                for (size_t i = 0; i < data.size(); i++) {
+                    if (validity.get(i)) {
+                        result.push_back(static_cast<double>(data[i]));
+                    }
+                }
+            }
+        }
+    });
+    return result;
+}
+
+// Occurrences of every dictionary code among the non-null cells
+template<class DataType>
+std::vector<size_t> Column<DataType>::codeCounts() const {
+    const DictionaryArray& dictionary = this->storage->getDictionary();
+    const std::vector<uint32_t>& codes = dictionary.getCodes();
+    const ValidityBitmap& validity = this->storage->getValidity();
+    std::vector<size_t> counts(dictionary.cardinality(), 0);
+    for (size_t i = 0; i < codes.size(); i++) {
+        if (validity.get(i)) {
+            counts[codes[i]]++;
+        }
+    }
+    return counts;
+}
+
+template<class DataType>
+template<class T>
+DataType Column<DataType>::fromKey(const T& key) {
+    if constexpr (std::is_same_v<T, std::string_view>) {
+        return fromStored(std::string(key));
+    } else {
+        return fromStored(key);
+    }
+}
+
+// Calls visitor(key, count) once per distinct non-null value, strings come as
+// views into the buffer. Counting runs on a typed open addressing table, with
+// threads every slice of the rows gets its own table and they are merged.
+template<class DataType>
+template<class Visitor>
+void Column<DataType>::forEachValueCount(Visitor&& visitor, size_t threads) const {
+    if (this->isDictionaryEncoded()) {
+        std::vector<size_t> counts = this->codeCounts();
+        const std::vector<std::string>& dictionary = this->storage->getDictionary().getDictionary();
+        for (size_t code = 0; code < counts.size(); code++) {
+            if (counts[code] > 0) {
+                visitor(std::string_view(dictionary[code]), counts[code]);
+            }
+        }
+        return;
+    }
+    const ValidityBitmap& validity = this->storage->getValidity();
+    this->storage->visit([&](const auto& data) {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate> && !std::is_same_v<Storage, DictionaryArray>) {
+            using T = typename Storage::value_type;
+            using Key = std::conditional_t<std::is_same_v<T, std::string>, std::string_view, T>;
+            size_t n = data.size();
+            size_t workers = threads == 0 ? hardwareThreads() : threads;
+            size_t tasks = std::max<size_t>(1, std::min(workers, n / SORT_RANGE_SIZE));
+            std::vector<CountTable<Key>> tables(tasks);
+            parallelFor(tasks, workers, [&](size_t task, size_t) {
+                CountTable<Key>& table = tables[task];
+                for (size_t i = n * task / tasks; i < n * (task + 1) / tasks; i++) {
+                    if (validity.get(i)) {
+                        table.add(Key(data[i]));
+                    }
+                }
+            });
+            for (size_t task = 1; task < tasks; ++task) {
+                tables.front().merge(tables[task]);
+            }
+            tables.front().forEach(visitor);
+        }
+    });
+}
+
 // BASIC HANDLING
 
 template<class DataType>
 std::vector<std::optional<DataType>> Column<DataType>::getOptionalValues() const {
-    return this->values;
+    std::vector<std::optional<DataType>> extractedValues(this->size());
+    this->forEachValid([&extractedValues](const auto& value, size_t i) {
+        extractedValues[i] = fromStored(value);
+    });
+    return extractedValues;
 }
 
 template<class DataType>
 std::vector<DataType> Column<DataType>::getValues() const {
     std::vector<DataType> extractedValues;
-    for(auto& x : this->values) {
-        if(x.has_value()) {
-            extractedValues.push_back(x.value());
-        }
-    }
+    extractedValues.reserve(this->countNonNull());
+    this->forEachValid([&extractedValues](const auto& value, size_t) {
+        extractedValues.push_back(fromStored(value));
+    });
     return extractedValues;
 }
 
@@ -38,12 +189,12 @@ bool Column<DataType>::getIsPartOfDataFrame() const {
 
 template<class DataType>
 size_t Column<DataType>::size() const {
-    return this->values.size();
+    return this->storage->size();
 }
 
 template<class DataType>
 bool Column<DataType>::isEmpty() const {
-    return this->values.size() == 0;
+    return this->storage->size() == 0;
 }
 
 template<class DataType>
@@ -53,10 +204,10 @@ std::string Column<DataType>::getDataType() const {
 
 template<class DataType>
 bool Column<DataType>::isNull(size_t index) const {
-    if(index > this->size()) {
+    if(index >= this->size()) {
         throw InvalidIndexException();
     }
-    return !this->values[index].has_value();
+    return !this->storage->isValid(index);
 }
 
 template<class DataType>
@@ -115,19 +266,18 @@ template<class DataType>
 size_t Column<DataType>::getWidth() const {
     size_t maxWidth = name.length();
 
-    for (const auto& value : values) {
+    if (this->countNull() > 0) {
+        maxWidth = std::max(maxWidth, size_t(4));
+    }
+    this->forEachValid([&maxWidth](const auto& value, size_t) {
         size_t currentWidth = 0;
-        if (value.has_value()) {
-            if constexpr (std::is_same_v<DataType, std::string>) {
-                currentWidth = value.value().length();
-            } else {
-                currentWidth = std::to_string(value.value()).length();
-            }
+        if constexpr (std::is_same_v<std::decay_t<decltype(value)>, std::string>) {
+            currentWidth = value.length();
         } else {
-            currentWidth = 4;
+            currentWidth = std::to_string(value).length();
         }
         maxWidth = std::max(maxWidth, currentWidth);
-    }
+    });
     return maxWidth;
 }
 
@@ -138,11 +288,34 @@ size_t Column<DataType>::getWidth() const {
 template<class DataType>
 std::vector<size_t> Column<DataType>::find(const DataType& element) const {
     std::vector<size_t> indices;
-    for (size_t i = 0; i < values.size(); ++i) {
-        if (values[i].has_value() && values[i].value() == element) {
-            indices.push_back(i);
+    const ValidityBitmap& validity = this->storage->getValidity();
+    this->storage->visit([&](const auto& data) {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            std::optional<typename Storage::value_type> target = toStored<typename Storage::value_type>(element);
+            if (!target.has_value()) {
+                return;
+            }
+            if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+                std::optional<uint32_t> code = data.codeOf(*target);
+                if (!code.has_value()) {
+                    return;
+                }
+                const std::vector<uint32_t>& codes = data.getCodes();
+                for (size_t i = 0; i < codes.size(); i++) {
+                    if (codes[i] == *code && validity.get(i)) {
+                        indices.push_back(i);
+                    }
+                }
+            } else {
+                for (size_t i = 0; i < data.size(); i++) {
+                    if (validity.get(i) && data[i] == *target) {
+                        indices.push_back(i);
+                    }
+                }
+            }
         }
-    }
+    });
     return indices;
 }
 
@@ -154,32 +327,33 @@ void Column<DataType>::add(const std::optional<ColumnType> &element) {
 //    }
     checkDataFrameIntegrity();
     if(element.has_value()) {
-        values.push_back(std::visit([](auto&& value) -> DataType {
+        DataType value = std::visit([](auto&& value) -> DataType {
             if constexpr (std::is_convertible_v<std::decay_t<decltype(value)>, DataType>) {
                 return static_cast<DataType>(value);
             } else {
                 throw std::invalid_argument("Incompatible type in variant.");
             }
-        }, *element));
+        }, *element);
+        this->writeBuffer().append(ColumnType(value));
     }
     else {
-        values.push_back(std::nullopt);
+        this->writeBuffer().appendNull();
     }
 }
 
 template<class DataType>
 void Column<DataType>::addToColumnFromRow(const std::optional<DataType>& value) {
     if(value.has_value()) {
-        values.push_back(value.value());
+        this->writeBuffer().append(ColumnType(value.value()));
     }
     else {
-        values.push_back(std::nullopt);
+        this->writeBuffer().appendNull();
     }
 }
 
 template<class DataType>
 void Column<DataType>::add(const std::optional<ColumnType> &element, size_t index) {
-    if (index >= this->values.size()) throw InvalidIndexException();
+    if (index >= this->size()) throw InvalidIndexException();
 //    if (!isCompatibleType(element)) {
 //        throw std::invalid_argument("Type mismatch in the value added.");
 //    }
@@ -192,54 +366,47 @@ void Column<DataType>::add(const std::optional<ColumnType> &element, size_t inde
                 throw std::invalid_argument("Incompatible type in variant.");
             }
         }, *element);
-        values.insert(values.begin() + index, value);
+        this->writeBuffer().insert(index, ColumnType(value));
     }
     else {
-        values.insert(values.begin() + index, std::nullopt);
+        this->writeBuffer().insert(index, std::nullopt);
     }
 }
 
 template<class DataType>
 void Column<DataType>::removeAt(size_t index) {
-    if (index >= this->values.size()) throw InvalidIndexException();
+    if (index >= this->size()) throw InvalidIndexException();
     checkDataFrameIntegrity();
-    this->values.erase(this->values.begin() + index);
+    this->writeBuffer().erase(index);
 }
 
 template<class DataType>
 void Column<DataType>::removeAtFromRow(size_t index) {
-    this->values.erase(this->values.begin() + index);
+    this->writeBuffer().erase(index);
 }
 
 template<class DataType>
 void Column<DataType>::remove(const DataType &element) {
     checkDataFrameIntegrity();
-    for(size_t i = 0; i < this->values.size(); i++) {
-        if(this->values[i].has_value()) {
-            if(this->values[i].value() == element) {
-                this->values.erase(this->values.begin() + i);
-                break;
-            }
-        }
+    std::vector<size_t> indices = this->find(element);
+    if(!indices.empty()) {
+        this->writeBuffer().erase(indices.front());
     }
 }
 
 template<class DataType>
 void Column<DataType>::removeAll(const DataType& element) {
     checkDataFrameIntegrity();
-    for(size_t i = 0; i < this->values.size(); i++) {
-        if(this->values[i].has_value()) {
-            if(this->values[i].value() == element) {
-                this->values.erase(this->values.begin() + i);
-            }
-        }
+    std::vector<size_t> indices = this->find(element);
+    for(auto it = indices.rbegin(); it != indices.rend(); ++it) {
+        this->writeBuffer().erase(*it);
     }
 }
 
 template<class DataType>
 void Column<DataType>::update(size_t index, const DataType& element) {
-    if (index >= this->values.size()) throw InvalidIndexException();
-    this->values[index] = element;
+    if (index >= this->size()) throw InvalidIndexException();
+    this->writeBuffer().set(index, ColumnType(element));
 }
 
 template<class DataType>
@@ -258,60 +425,55 @@ void Column<DataType>::addAll(const Iterable &it) {
 template<class DataType>
 void Column<DataType>::removeNull() {
     checkDataFrameIntegrity();
-    for(size_t i = 0; i < this->values->size();) {
-        if(!this->values[i].has_value()) {
-            this->values.erase(this->values.begin() + i);
-        } else {
-            i++;
-        }
-    }
+    ColumnBuffer compacted(this->storage->kind());
+    compacted.reserve(this->countNonNull());
+    this->forEachValid([&compacted](const auto& value, size_t) {
+        compacted.append(ColumnType(std::in_place_type<std::decay_t<decltype(value)>>, value));
+    });
+    this->storage = std::make_shared<ColumnBuffer>(std::move(compacted));
 }
 
 template<class DataType>
 void Column<DataType>::replace(const DataType &oldValue, const DataType &newValue) {
-    for (auto& val : values) {
-        if(val.has_value() && val.value() == oldValue) {
-            val = newValue;
-        }
-    }
+    this->writeBuffer().replaceAll(ColumnType(oldValue), ColumnType(newValue));
 }
 
 template<class DataType>
 template<class Predicate>
 void Column<DataType>::removeIf(Predicate pred) {
     checkDataFrameIntegrity();
-    auto it = std::remove_if(values.begin(), values.end(),
-                             [&](const std::optional<DataType>& val) {
-                                 return val.has_value() && pred(val.value());
-                             });
-    values.erase(it, values.end());
+    std::vector<size_t> indices;
+    this->forEachValid([&](const auto& value, size_t i) {
+        if (pred(fromStored(value))) {
+            indices.push_back(i);
+        }
+    });
+    for(auto it = indices.rbegin(); it != indices.rend(); ++it) {
+        this->writeBuffer().erase(*it);
+    }
 }
 
 template<class DataType>
 void Column<DataType>::fillNull(const DataType &value) {
-    for(size_t i = 0; i < this->values.size(); i++) {
-        if(!this->values[i].has_value()) {
-            this->values[i] = value;
+    for(size_t i = 0; i < this->size(); i++) {
+        if(!this->storage->isValid(i)) {
+            this->writeBuffer().set(i, ColumnType(value));
         }
     }
 }
 
 template<class DataType>
 void Column<DataType>::fillNullWithMean() requires Numeric<DataType> {
-    DataType mean = this->mean();
-    for(size_t i = 0; i < this->values.size(); i++) {
-        if(!this->values[i].has_value()) {
-            this->values[i] = mean;
-        }
-    }
+    this->fillNull(fromDouble(this->mean()));
 }
 
 template<class DataType>
 void Column<DataType>::fillNull() {
-    for(size_t i = 0; i < this->values.size(); i++) {
-        if(!this->values[i].has_value()) {
-            this->values[i] = DataType();
-        }
+    if(this->storage->isTyped()) {
+        // null slots already hold default constructed values
+        this->writeBuffer().markAllValid();
+    } else {
+        this->fillNull(DataType());
     }
 }
 
@@ -324,19 +486,24 @@ DataType Column<DataType>::min() const {
     if(this->isEmpty()) {
         throw EmptyColumnException();
     }
-    if(std::none_of(this->values.begin(), this->values.end(), [](const auto& val) { return val.has_value(); })) {
+    if(this->countNonNull() == 0) {
         throw NoValidValuesException();
     }
-    DataType minValue;
-    bool foundValidValue = false;
-    std::vector<DataType> filteredValues = this->getValues();
-    for(const auto& val : filteredValues) {
-        if (!foundValidValue || val < minValue) {
-            minValue = val;
-            foundValidValue = true;
+    const ValidityBitmap& validity = this->storage->getValidity();
+    return this->storage->visit([&validity](const auto& data) -> DataType {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (std::is_same_v<Storage, std::monostate>) {
+            throw NoValidValuesException();
+        } else {
+            size_t minIndex = data.size();
+            for (size_t i = 0; i < data.size(); i++) {
+                if (validity.get(i) && (minIndex == data.size() || data[i] < data[minIndex])) {
+                    minIndex = i;
+                }
+            }
+            return fromStored<typename Storage::value_type>(data[minIndex]);
         }
-    }
-    return minValue;
+    });
 }
 
 template<class DataType>
@@ -344,19 +511,133 @@ DataType Column<DataType>::max() const {
     if(this->isEmpty()) {
         throw EmptyColumnException();
     }
-    if(std::none_of(this->values.begin(), this->values.end(), [](const auto& val) { return val.has_value(); })) {
+    if(this->countNonNull() == 0) {
         throw NoValidValuesException();
     }
-    DataType maxValue;
-    bool foundValidValue = false;
-    std::vector<DataType> filteredValues = this->getValues();
-    for(const auto& val : filteredValues) {
-        if (!foundValidValue || val > maxValue) {
-            maxValue = val;
-            foundValidValue = true;
+    const ValidityBitmap& validity = this->storage->getValidity();
+    return this->storage->visit([&validity](const auto& data) -> DataType {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (std::is_same_v<Storage, std::monostate>) {
+            throw NoValidValuesException();
+        } else {
+            size_t maxIndex = data.size();
+            for (size_t i = 0; i < data.size(); i++) {
+                if (validity.get(i) && (maxIndex == data.size() || data[i] > data[maxIndex])) {
+                    maxIndex = i;
+                }
+            }
+            return fromStored<typename Storage::value_type>(data[maxIndex]);
+        }
+    });
+}
+
+// First valid row in [begin, end) holding value, the first valid row at all
+// when only NaNs were there to compare
+template<class T>
+static size_t firstRowOf(const std::vector<T>& data, const ValidityBitmap& validity, size_t begin, size_t end, T value) {
+    size_t firstValid = NO_ROW;
+    for (size_t i = begin; i < end; i++) {
+        if (validity.get(i)) {
+            if (data[i] == value) return i;
+            if (firstValid == NO_ROW) firstValid = i;
         }
     }
-    return maxValue;
+    return firstValid;
+}
+
+// Every thread summarizes its slice chunk by chunk, slices merge in row order
+ColumnStats rangeStats(const ColumnBuffer& buffer, size_t begin, size_t end, size_t threads) {
+    ColumnStats result;
+    const ValidityBitmap& validity = buffer.getValidity();
+    buffer.visit([&](const auto& data) {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            using T = typename Storage::value_type;
+            auto less = [&data](size_t a, size_t b) { return data[a] < data[b]; };
+            size_t n = end - begin;
+            size_t workers = threads == 0 ? hardwareThreads() : threads;
+            size_t tasks = std::max<size_t>(1, std::min(workers, n / SORT_RANGE_SIZE));
+            std::vector<ColumnStats> partials(tasks);
+            parallelFor(tasks, workers, [&](size_t task, size_t) {
+                size_t taskEnd = begin + n * (task + 1) / tasks;
+                if constexpr (std::is_same_v<T, int> || std::is_same_v<T, double>) {
+                    // vector kernels reduce every chunk to values, only the chunks holding
+                    // the extremes are searched for their rows afterwards
+                    const uint64_t* words = validity.getWords().data();
+                    std::optional<T> low, high;
+                    size_t lowChunk = 0, highChunk = 0;
+                    for (size_t chunkBegin = begin + n * task / tasks; chunkBegin < taskEnd; chunkBegin += STATS_CHUNK_SIZE) {
+                        size_t chunkEnd = std::min(taskEnd, chunkBegin + STATS_CHUNK_SIZE);
+                        ColumnStats chunk;
+                        chunk.numeric = true;
+                        chunk.count = countValid(words, chunkBegin, chunkEnd);
+                        chunk.nullCount = chunkEnd - chunkBegin - chunk.count;
+                        if (chunk.count == 0) {
+                            partials[task].merge(chunk, less);
+                            continue;
+                        }
+                        chunk.sum = static_cast<double>(sumValid(data.data(), words, chunkBegin, chunkEnd));
+                        if (chunk.count > 1) {
+                            chunk.m2 = squaredDeviations(data.data(), words, chunkBegin, chunkEnd, chunk.mean());
+                        }
+                        MinMax<T> extremes = minMaxValid(data.data(), words, chunkBegin, chunkEnd);
+                        if (!low.has_value() || extremes.min < *low) {
+                            low = extremes.min;
+                            lowChunk = chunkBegin;
+                        }
+                        if (!high.has_value() || *high < extremes.max) {
+                            high = extremes.max;
+                            highChunk = chunkBegin;
+                        }
+                        partials[task].merge(chunk, less);
+                    }
+                    if (low.has_value()) {
+                        partials[task].minRow = firstRowOf(data, validity, lowChunk, std::min(taskEnd, lowChunk + STATS_CHUNK_SIZE), *low);
+                        partials[task].maxRow = firstRowOf(data, validity, highChunk, std::min(taskEnd, highChunk + STATS_CHUNK_SIZE), *high);
+                    }
+                    return;
+                }
+                for (size_t chunkBegin = begin + n * task / tasks; chunkBegin < taskEnd; chunkBegin += STATS_CHUNK_SIZE) {
+                    size_t chunkEnd = std::min(taskEnd, chunkBegin + STATS_CHUNK_SIZE);
+                    ColumnStats chunk;
+                    for (size_t i = chunkBegin; i < chunkEnd; i++) {
+                        if (!validity.get(i)) {
+                            chunk.nullCount++;
+                            continue;
+                        }
+                        if (chunk.minRow == NO_ROW || data[i] < data[chunk.minRow]) chunk.minRow = i;
+                        if (chunk.maxRow == NO_ROW || data[chunk.maxRow] < data[i]) chunk.maxRow = i;
+                        chunk.count++;
+                        if constexpr (Numeric<T>) {
+                            chunk.sum += static_cast<double>(data[i]);
+                        }
+                    }
+                    chunk.numeric = Numeric<T>;
+                    if constexpr (Numeric<T>) {
+                        double chunkMean = chunk.mean();
+                        for (size_t i = chunkBegin; i < chunkEnd && chunk.count > 1; i++) {
+                            if (validity.get(i)) {
+                                double deviation = static_cast<double>(data[i]) - chunkMean;
+                                chunk.m2 += deviation * deviation;
+                            }
+                        }
+                    }
+                    partials[task].merge(chunk, less);
+                }
+            });
+            for (const ColumnStats& partial : partials) {
+                result.merge(partial, less);
+            }
+        } else {
+            result.nullCount = end - begin;
+        }
+    });
+    return result;
+}
+
+template<class DataType>
+ColumnStats Column<DataType>::stats(size_t threads) const {
+    return rangeStats(*this->storage, 0, this->size(), threads);
 }
 
 template<class DataType>
@@ -364,30 +645,10 @@ double Column<DataType>::mean() const requires DecayedOrDirectNumeric<DataType>
     if(this->isEmpty()) {
         throw EmptyColumnException();
     }
-    if(std::none_of(this->values.begin(), this->values.end(), [](const auto& val) { return val.has_value(); })) {
+    if(this->countNonNull() == 0) {
         throw NoValidValuesException();
     }
-    double sum = 0.0;
-    size_t count = 0;
-    for (const auto& val : this->getValues()) {
-        if constexpr (std::is_same_v<DataType, ColumnType>) {
-            std::visit([&sum, &count](const auto& v) {
-                using T = std::decay_t<decltype(v)>;
-                if constexpr (Numeric<T>) {
-                    sum += static_cast<double>(v);
-                    ++count;
-                }
-            }, val);
-        } else {
-            sum += static_cast<double>(val);
-            ++count;
-        }
-    }
-
-    if (count == 0) {
-        return std::nan("");
-    }
-    return sum / count;
+    return this->stats().mean();
 }
 
 //template<>
@@ -426,26 +687,13 @@ double Column<DataType>::mean() const requires DecayedOrDirectNumeric<DataType>
 template<class DataType>
 double Column<DataType>::median() const requires DecayedOrDirectNumeric<DataType> {
     if(this->isEmpty()) throw EmptyColumnException();
-    if(std::none_of(this->values.begin(), this->values.end(), [](const auto& val) { return val.has_value(); })) {
+    if(this->countNonNull() == 0) {
         throw NoValidValuesException();
     }
-    std::vector<double> filteredValues;
-    for (const auto& val : this->getValues()) {
-        if constexpr (std::is_same_v<DataType, ColumnType>) {
-            std::visit([&filteredValues](const auto& v) {
-                using T = std::decay_t<decltype(v)>;
-                if constexpr (Numeric<T>) {
-                    filteredValues.push_back(static_cast<double>(v));
-                }
-            }, val);
-        } else {
-            filteredValues.push_back(static_cast<double>(val));
-        }
-    }
+    std::vector<double> filteredValues = this->numericValues();
     if (filteredValues.empty()) return std::nan("");
-    std::sort(filteredValues.begin(), filteredValues.end());
-
     size_t size = filteredValues.size();
+    selectRanks(filteredValues, {(size - 1) / 2, size / 2});
     if (size % 2 == 0) {
         return (filteredValues[size / 2 - 1] + filteredValues[size / 2]) / 2.0;
     }
@@ -455,32 +703,10 @@ double Column<DataType>::median() const requires DecayedOrDirectNumeric<DataType
 template<class DataType>
 double Column<DataType>::std() const requires DecayedOrDirectNumeric<DataType> {
     if(this->isEmpty()) throw EmptyColumnException();
-    if(std::none_of(this->values.begin(), this->values.end(), [](const auto& val) { return val.has_value(); })) {
+    if(this->countNonNull() == 0) {
         throw NoValidValuesException();
     }
-    double mean = this->mean();
-    double ssq = 0.0;
-    size_t count = 0;
-    for (const auto& val : this->getValues()) {
-        if constexpr (std::is_same_v<DataType, ColumnType>) {
-            std::visit([&ssq, &mean, &count](const auto& v) {
-                using T = std::decay_t<decltype(v)>;
-                if constexpr (Numeric<T>) {
-                    ssq += (static_cast<double>(v) - mean) * (static_cast<double>(v) - mean);
-                    ++count;
-                }
-            }, val);
-        } else {
-            ssq += (static_cast<double>(val) - mean) * (static_cast<double>(val) - mean);
-            ++count;
-        }
-    }
-
-    if (count < 2) {
-        return std::nan("");
-    }
-
-    return std::sqrt(ssq / (count - 1));
+    return this->stats().stddev();
 }
 
 //template<>
@@ -513,25 +739,29 @@ double Column<DataType>::std() const requires DecayedOrDirectNumeric<DataType> {
 
 template<class DataType>
 double Column<DataType>::var() const requires DecayedOrDirectNumeric<DataType> {
-    return std::pow(this->std(), 2);
+    if(this->isEmpty()) throw EmptyColumnException();
+    if(this->countNonNull() == 0) {
+        throw NoValidValuesException();
+    }
+    return this->stats().variance();
 }
 
 template<class DataType>
 DataType Column<DataType>::percentile(double p) const requires DecayedOrDirectNumeric<DataType> {
     if(this->isEmpty()) throw EmptyColumnException();
-    if(std::none_of(this->values.begin(), this->values.end(), [](const auto& val) { return val.has_value(); })) {
+    if(this->countNonNull() == 0) {
         throw NoValidValuesException();
     }
-    if (p < 0.0 || p > 1.0) {
+    if (!(p >= 0.0 && p <= 1.0)) {
         throw std::invalid_argument("Percentile must be between 0 and 1.");
     }
     std::vector<DataType> filteredValues = this->getValues();
-    std::sort(filteredValues.begin(), filteredValues.end());
     size_t n = filteredValues.size();
 
     double pos = (n - 1) * p;
     auto lower_index = static_cast<size_t>(std::floor(pos));
     auto upper_index = static_cast<size_t>(std::ceil(pos));
+    selectRanks(filteredValues, {lower_index, upper_index});
 
     if (lower_index == upper_index) {
         return filteredValues[lower_index];
@@ -542,6 +772,67 @@ DataType Column<DataType>::percentile(double p) const requires DecayedOrDirectNu
     }
 }
 
+// All requested quantiles come out of one multi-rank selection over a single copy
+template<class DataType>
+std::vector<double> Column<DataType>::percentiles(const std::vector<double>& ps) const requires DecayedOrDirectNumeric<DataType> {
+    if(this->isEmpty()) throw EmptyColumnException();
+    if(this->countNonNull() == 0) {
+        throw NoValidValuesException();
+    }
+    for (double p : ps) {
+        if (!(p >= 0.0 && p <= 1.0)) {
+            throw std::invalid_argument("Percentile must be between 0 and 1.");
+        }
+    }
+    std::vector<double> filteredValues = this->numericValues();
+    size_t n = filteredValues.size();
+    if (n == 0) return std::vector<double>(ps.size(), std::nan(""));
+    std::vector<size_t> ranks;
+    for (double p : ps) {
+        double pos = (n - 1) * p;
+        ranks.push_back(static_cast<size_t>(std::floor(pos)));
+        ranks.push_back(static_cast<size_t>(std::ceil(pos)));
+    }
+    selectRanks(filteredValues, ranks);
+
+    std::vector<double> result;
+    result.reserve(ps.size());
+    for (double p : ps) {
+        double pos = (n - 1) * p;
+        auto lower_index = static_cast<size_t>(std::floor(pos));
+        auto upper_index = static_cast<size_t>(std::ceil(pos));
+        double lower_value = filteredValues[lower_index];
+        double upper_value = filteredValues[upper_index];
+        result.push_back(lower_value + (pos - lower_index) * (upper_value - lower_value));
+    }
+    return result;
+}
+
+// Every thread sketches its own slice of the rows, the slices are merged after
+template<class DataType>
+QuantileSketch Column<DataType>::quantileSketch(double accuracy, size_t threads) const requires DecayedOrDirectNumeric<DataType> {
+    threads = threads == 0 ? hardwareThreads() : threads;
+    size_t n = this->size();
+    size_t tasks = std::max<size_t>(1, std::min(threads, n / SORT_RANGE_SIZE));
+    std::vector<QuantileSketch> sketches(tasks, QuantileSketch::withAccuracy(accuracy));
+    parallelFor(tasks, threads, [&](size_t task, size_t) {
+        sketches[task].update(*this->storage, n * task / tasks, n * (task + 1) / tasks);
+    });
+    for (size_t task = 1; task < tasks; ++task) {
+        sketches.front().merge(sketches[task]);
+    }
+    return sketches.front();
+}
+
+template<class DataType>
+double Column<DataType>::approxPercentile(double p, double accuracy) const requires DecayedOrDirectNumeric<DataType> {
+    if(this->isEmpty()) throw EmptyColumnException();
+    if(this->countNonNull() == 0) {
+        throw NoValidValuesException();
+    }
+    return this->quantileSketch(accuracy).quantile(p);
+}
+
 template<class DataType>
 double Column<DataType>::skewness() const requires DecayedOrDirectNumeric<DataType> {
     double mean = this->mean();
@@ -569,16 +860,36 @@ DataType Column<DataType>::range() const requires DecayedOrDirectNumeric<DataTyp
 template<class DataType>
 DataType Column<DataType>::mode() const {
     if(isEmpty()) throw EmptyColumnException();
-    if(std::none_of(this->values.begin(), this->values.end(), [](const auto& val) { return val.has_value(); })) {
+    if(this->countNonNull() == 0) {
         throw NoValidValuesException();
     }
 
-    std::map<DataType, size_t> valueCounts = this->valueCounts();
-    auto modeIt = std::max_element(valueCounts.begin(), valueCounts.end(),
-                                   [](const auto& a, const auto& b) {
-                                        return a.second < b.second;
+    if (this->isDictionaryEncoded()) {
+        // ties resolve to the smallest value, like the ordered map below
+        std::vector<size_t> counts = this->codeCounts();
+        const std::vector<std::string>& dictionary = this->storage->getDictionary().getDictionary();
+        size_t best = 0;
+        for (size_t code = 1; code < counts.size(); code++) {
+            if (counts[code] > counts[best] || (counts[code] == counts[best] && counts[code] > 0 && dictionary[code] < dictionary[best])) {
+                best = code;
+            }
+        }
+        return fromStored<std::string>(dictionary[best]);
+    }
+    // ties resolve to the smallest value
+    std::optional<DataType> best;
+    size_t bestCount = 0;
+    this->forEachValueCount([&](const auto& key, size_t count) {
+        if (count < bestCount) {
+            return;
+        }
+        DataType value = fromKey(key);
+        if (count > bestCount || value < *best) {
+            best = std::move(value);
+            bestCount = count;
+        }
     });
-    return modeIt->first;
+    return *best;
 }
 
 // END AGGREGATIONS
@@ -587,18 +898,41 @@ DataType Column<DataType>::mode() const {
 
 template<class DataType>
 int Column<DataType>::countNonNull() const {
-    return this->getValues().size();
+    return this->storage->getValidity().countValid();
 }
 
 template<class DataType>
 int Column<DataType>::countNull() const {
-    return this->getOptionalValues().size() - this->getValues().size();
+    return this->size() - this->countNonNull();
 }
 
 template<class DataType>
 int Column<DataType>::countDistinct() const {
-    std::set<DataType> s(this->getValues().begin(), this->getValues().end());
-    return s.size();
+    size_t distinct = 0;
+    this->forEachValueCount([&distinct](const auto&, size_t) {
+        distinct++;
+    });
+    return distinct;
+}
+
+template<class DataType>
+DistinctSketch Column<DataType>::distinctSketch(unsigned precision, size_t threads) const {
+    threads = threads == 0 ? hardwareThreads() : threads;
+    size_t n = this->size();
+    size_t tasks = std::max<size_t>(1, std::min(threads, n / SORT_RANGE_SIZE));
+    std::vector<DistinctSketch> sketches(tasks, DistinctSketch(precision));
+    parallelFor(tasks, threads, [&](size_t task, size_t) {
+        sketches[task].update(*this->storage, n * task / tasks, n * (task + 1) / tasks);
+    });
+    for (size_t task = 1; task < tasks; ++task) {
+        sketches.front().merge(sketches[task]);
+    }
+    return sketches.front();
+}
+
+template<class DataType>
+size_t Column<DataType>::approxCountDistinct(unsigned precision, size_t threads) const {
+    return static_cast<size_t>(std::llround(this->distinctSketch(precision, threads).estimate()));
 }
 
 // END COUNT BASED AGGREGATIONS
@@ -608,12 +942,30 @@ int Column<DataType>::countDistinct() const {
 template<class DataType>
 std::map<DataType, size_t> Column<DataType>::valueCounts() const {
     std::map<DataType, size_t> map;
-    for(auto& val : this->getValues()) {
-        map[val]++;
-    }
+    this->forEachValueCount([&map](const auto& key, size_t count) {
+        map.emplace(fromKey(key), count);
+    });
     return map;
 }
 
+template<class DataType>
+std::vector<std::pair<DataType, size_t>> Column<DataType>::valueCounts(ValueCountOrder order, size_t threads) const {
+    std::vector<std::pair<DataType, size_t>> counts;
+    this->forEachValueCount([&counts](const auto& key, size_t count) {
+        counts.emplace_back(fromKey(key), count);
+    }, threads);
+    if (order == ValueCountOrder::Frequency) {
+        std::sort(counts.begin(), counts.end(), [](const auto& a, const auto& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+    } else if (order == ValueCountOrder::Value) {
+        std::sort(counts.begin(), counts.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+    }
+    return counts;
+}
+
 template<class DataType>
 std::vector<size_t> Column<DataType>::histogram(size_t numberOfBins) const requires DecayedOrDirectNumeric<DataType> {
     DataType range = this->range();
@@ -648,28 +1000,60 @@ std::string Column<DataType>::concatenate(const std::string& linker) const requi
 
 template<class DataType>
 Column<DataType> Column<DataType>::sort(bool ascending) requires Sortable<DataType> {
-    Column<DataType> copy = Column<DataType>(*this);
+    std::vector<DataType> sortedValues = this->getValues();
     if(ascending) {
-        std::sort(copy.values.begin(), copy.values.end());
+        std::sort(sortedValues.begin(), sortedValues.end());
     }
     else {
-        std::sort(copy.values.begin(), copy.values.end(), std::greater<>());
+        std::sort(sortedValues.begin(), sortedValues.end(), std::greater<>());
+    }
+    // nulls compare lower than any value
+    Column<DataType> copy = Column<DataType>(this->name, ColumnBuffer(this->storage->kind()));
+    size_t nullCount = this->countNull();
+    if(ascending) {
+        for(size_t i = 0; i < nullCount; i++) copy.writeBuffer().appendNull();
+    }
+    for(const auto& value : sortedValues) {
+        copy.writeBuffer().append(ColumnType(value));
+    }
+    if(!ascending) {
+        for(size_t i = 0; i < nullCount; i++) copy.writeBuffer().appendNull();
     }
     return copy;
 }
 
+template<class DataType>
+Column<DataType> Column<DataType>::topK(size_t k, bool largest, size_t threads) const {
+    return Column<DataType>(this->name, this->storage->gather(topRows({this->storage.get()}, k, largest, threads)));
+}
+
 // FILTER
 
 template<class DataType>
 template<class Predicate>
 Column<DataType> Column<DataType>::filter(Predicate pred) const {
-    Column<DataType> result(this->name + "_filtered");
-    for(const auto& val : this->getValues()) {
-        if(pred(val)) {
-            result.add(val);
+    Bitmask mask(this->size(), false);
+    this->forEachValid([&](const auto& value, size_t i) {
+        if (pred(fromStored(value))) {
+            mask.set(i, true);
+        }
+    });
+    return Column<DataType>(this->name + "_filtered", this->storage->filter(mask));
+}
+
+template<class DataType>
+Column<DataType> Column<DataType>::take(const std::vector<size_t>& indices) const {
+    for (size_t index : indices) {
+        if (index != NO_ROW && index >= this->size()) {
+            throw InvalidIndexException();
         }
     }
-    return result;
+    return Column<DataType>(this->name, this->storage->gather(indices));
+}
+
+template<class DataType>
+Column<DataType> Column<DataType>::filter(const Bitmask& mask) const {
+    return Column<DataType>(this->name, this->storage->filter(mask));
 }
 
 // OPERATORS
@@ -679,7 +1063,7 @@ Column<DataType> Column<DataType>::filter(Predicate pred) const {
 template<class DataType>
 Column<DataType> Column<DataType>::applyOperation(const DataType& value, std::function<DataType(const DataType&, const DataType&)> op) const requires DecayedOrDirectNumeric<DataType> {
     Column<DataType> result(this->name + "_operation");
-    for(const auto& val : this->values) {
+    for(const auto& val : this->getOptionalValues()) {
         if(val.has_value()) {
             result.add(op(val.value(), value));
         }
@@ -691,36 +1075,38 @@ Column<DataType> Column<DataType>::applyOperation(const DataType& value, std::fu
 }
 
 template<class DataType>
-Column<DataType> Column<DataType>::operator+(const DataType& value) const requires DecayedOrDirectNumeric<DataType> {
+Column<DataType> Column<DataType>::operator+(const DataType& value) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>) {
     return applyOperation(value, std::plus<DataType>());
 }
 
 template<class DataType>
-Column<DataType> Column<DataType>::operator-(const DataType& value) const requires DecayedOrDirectNumeric<DataType> {
+Column<DataType> Column<DataType>::operator-(const DataType& value) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>) {
     return applyOperation(value, std::minus<DataType>());
 }
 
 template<class DataType>
-Column<DataType> Column<DataType>::operator*(const DataType& value) const requires DecayedOrDirectNumeric<DataType> {
+Column<DataType> Column<DataType>::operator*(const DataType& value) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>) {
     return applyOperation(value, std::multiplies<DataType>());
 }
 
 template<class DataType>
-Column<DataType> Column<DataType>::operator/(const DataType& value) const requires DecayedOrDirectNumeric<DataType> {
+Column<DataType> Column<DataType>::operator/(const DataType& value) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>) {
     return applyOperation(value, std::divides<DataType>());
 }
 
 template<class DataType>
 Column<DataType> Column<DataType>::applyOperation(const Column<DataType>& other, std::function<DataType(const DataType&, const DataType&)> op) const requires DecayedOrDirectNumeric<DataType> {
-    if (this->values.size() != other.values.size()) {
+    if (this->size() != other.size()) {
         throw InvalidSizeException();
     }
 
     Column<DataType> result(this->name + "_operation_" + other.name);
+    std::vector<std::optional<DataType>> lhs = this->getOptionalValues();
+    std::vector<std::optional<DataType>> rhs = other.getOptionalValues();
 
-    for (size_t i = 0; i < this->values.size(); ++i) {
-        if (this->values[i].has_value() && other.values[i].has_value()) {
-            result.add(op(this->values[i].value(), other.values[i].value()));
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        if (lhs[i].has_value() && rhs[i].has_value()) {
+            result.add(op(lhs[i].value(), rhs[i].value()));
         } else {
             result.add(std::nullopt);
         }
@@ -730,31 +1116,41 @@ Column<DataType> Column<DataType>::applyOperation(const Column<DataType>& other,
 }
 
 template<class DataType>
-Column<DataType> Column<DataType>::operator+(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> {
+Column<DataType> Column<DataType>::operator+(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>) {
     return applyOperation(other, std::plus<DataType>());
 }
 
 template<class DataType>
-Column<DataType> Column<DataType>::operator-(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> {
+Column<DataType> Column<DataType>::operator-(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>) {
     return applyOperation(other, std::minus<DataType>());
 }
 
 template<class DataType>
-Column<DataType> Column<DataType>::operator*(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> {
+Column<DataType> Column<DataType>::operator*(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>) {
     return applyOperation(other, std::multiplies<DataType>());
 }
 
 template<class DataType>
-Column<DataType> Column<DataType>::operator/(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> {
+Column<DataType> Column<DataType>::operator/(const Column<DataType>& other) const requires DecayedOrDirectNumeric<DataType> && (!FusedNumeric<DataType>) {
     return applyOperation(other, std::divides<DataType>());
 }
 
 template<class DataType>
 std::optional<DataType> Column<DataType>::operator[](size_t index) const {
-    if (index >= values.size()) {
+    if (index >= this->size()) {
         throw InvalidIndexException();
     }
-    return values[index];
+    if (!this->storage->isValid(index)) {
+        return std::nullopt;
+    }
+    return this->storage->visit([index](const auto& data) -> std::optional<DataType> {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (std::is_same_v<Storage, std::monostate>) {
+            return std::nullopt;
+        } else {
+            return fromStored<typename Storage::value_type>(data[index]);
+        }
+    });
 }
 
 
@@ -1,12 +1,33 @@
 #include "include/dataframe.h"
 #include "include/exceptions.h"
 #include "include/column.h"
+#include "include/buffer.h"
+#include "src/buffer.cpp"
+#include "include/simd.h"
+#include "src/simd.cpp"
+#include "include/sketch.h"
+#include "src/sketch.cpp"
 #include "src/column.cpp"
+#include "include/expression.h"
+#include "src/expression.cpp"
+#include "include/parallel.h"
+#include "src/parallel.cpp"
+#include "include/groupby.h"
+#include "src/groupby.cpp"
+#include "include/sort.h"
+#include "src/sort.cpp"
+#include "include/join.h"
+#include "src/join.cpp"
+#include "include/predicate.h"
+#include "src/predicate.cpp"
+#include "include/view.h"
+#include "src/view.cpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <map>
 #include <any>
+#include <numeric>
 
 // BASIC HANDLING
 
@@ -17,8 +38,8 @@ std::string DataFrame::getName() const {
 std::vector<Column<ColumnType>> DataFrame::getColumns() const {
     std::vector<Column<ColumnType>> columnVector;
 
-    for(const auto& pair : this->columns) {
-        columnVector.push_back(pair.second);
+    for(const auto& column : this->columns) {
+        columnVector.push_back(column);
     }
 
     return columnVector;
@@ -33,7 +54,7 @@ size_t DataFrame::numberOfColumns() const {
 }
 
 size_t DataFrame::numberOfRows() const {
-    return this->columns.empty() ? 0 : this->columns.begin()->second.size();
+    return this->columns.empty() ? 0 : this->columns.front().size();
 }
 
 std::pair<size_t, size_t> DataFrame::shape() const {
@@ -48,7 +69,7 @@ bool DataFrame::isEmpty() const {
 std::vector<std::string> DataFrame::columnNames() const {
     std::vector<std::string> r;
     r.reserve(this->columns.size());
-    for(auto& col : this->getColumns()) {
+    for(const auto& col : this->columns) {
         r.push_back(col.getName());
     }
     return r;
@@ -59,55 +80,76 @@ std::vector<std::string> DataFrame::columnNames() const {
 // DATA MANIPULATION
 
 Column<ColumnType>& DataFrame::getColumn(size_t index) {
-    for (const auto& pair : columnIndex) {
-        if (pair.second == index) {
-            const std::string& columnName = pair.first;
-            return columns.at(columnName);
-        }
+    if (index >= this->columns.size()) {
+        throw std::out_of_range("Index not found in columnIndex");
     }
-
-    throw std::out_of_range("Index not found in columnIndex");
+    return this->columns[index];
 }
 
 Column<ColumnType>& DataFrame::getColumn(const std::string &n) {
-    if (columnIndex.find(n) == columnIndex.end()) {
+    auto it = this->columnIndex.find(n);
+    if (it == this->columnIndex.end()) {
         throw std::runtime_error("Column not found");
     }
-    return columns.at(n);
+    return this->columns[it->second];
+}
+
+// Puts the column in the slot of an existing one with the same name, otherwise behind the last one
+void DataFrame::placeColumn(Column<ColumnType> column) {
+    auto [it, inserted] = this->columnIndex.try_emplace(column.getName(), this->columns.size());
+    if (inserted) {
+        this->columns.push_back(std::move(column));
+    } else {
+        this->columns[it->second] = std::move(column);
+    }
 }
 
 template<class T>
 void DataFrame::addColumn(const Column<T>& column) {
     if (this->numberOfColumns() != 0) {
-        if (column.size() != this->columns.begin()->second.size()) {
+        if (column.size() != this->columns.front().size()) {
             throw InvalidSizeException();
         }
     }
-    Column<ColumnType> newColumn(column.getName());
-    for (const auto& value : column.getOptionalValues()) {
-        if (value.has_value()) {
-            newColumn.add(std::optional<ColumnType>(*value));
-        } else {
-            newColumn.add(std::nullopt);
-        }
+    if (this->columnIndex.contains(column.getName())) {
+        throw std::runtime_error("Column with the same name already exists");
+    }
+    // every Column shares the same typed buffer layout, no per-cell conversion needed
+    this->placeColumn(Column<ColumnType>(column.getName(), column.shareBuffer()));
+}
+
+// Takes over a typed buffer without going through Column conversions
+void DataFrame::addBuffer(const std::string& columnName, ColumnBuffer buffer) {
+    this->addBuffer(columnName, std::make_shared<const ColumnBuffer>(std::move(buffer)));
+}
+
+// Shares a buffer with the frame it came from until either side changes it
+void DataFrame::addBuffer(const std::string& columnName, std::shared_ptr<const ColumnBuffer> buffer) {
+    if (this->numberOfColumns() != 0 && buffer->size() != this->numberOfRows()) {
+        throw InvalidSizeException();
     }
-    const std::string& columnName = newColumn.getName();
-    if (this->columns.find(columnName) != this->columns.end()) {
+    if (this->columnIndex.contains(columnName)) {
         throw std::runtime_error("Column with the same name already exists");
     }
-    this->columns[columnName] = newColumn;
-    this->columnIndex[columnName] = this->columns.size() - 1;
+    this->placeColumn(Column<ColumnType>(columnName, std::move(buffer)));
 }
 
 void DataFrame::addColumn(const std::string& columnName) {
-    columns[columnName] = Column<ColumnType>(columnName);
-    columnIndex[columnName] = this->columns.size() - 1;
+    this->placeColumn(Column<ColumnType>(columnName));
 }
 
 void DataFrame::addColumn() {
-    Column<ColumnType> newColumn = Column<ColumnType>();
-    columns[newColumn.getName()] = newColumn;
-    columnIndex[newColumn.getName()] = this->columns.size() - 1;
+    this->placeColumn(Column<ColumnType>());
+}
+
+// Cells whose type differs from the kind already fixed for the column are stored as null
+bool DataFrame::isTypeMismatch(const Column<ColumnType>& column, const ColumnType& value) {
+    ColumnKind columnKind = column.getKind();
+    ColumnKind valueKind = kindOf(value);
+    if (columnKind == ColumnKind::Untyped || columnKind == valueKind) {
+        return false;
+    }
+    return !(isStringKind(columnKind) && isStringKind(valueKind));
 }
 
 void DataFrame::addRow(const std::vector<std::optional<ColumnType>>& row) {
@@ -117,44 +159,13 @@ void DataFrame::addRow(const std::vector<std::optional<ColumnType>>& row) {
     }
 
     size_t i = 0;
-    for(auto& colPair : columns) {
-        Column<ColumnType>& column = colPair.second;
-
-        if(i < row.size()) {
-            const auto& cellValue = row[i];
-            if(cellValue.has_value()) {
-                bool typeMismatch = false;
-                try {
-                    if(column.getValues().empty()) {
-                        typeMismatch = false;
-                    }
-                    else {
-                        auto firstNonNull = column.getValues()[0];
-                        std::visit([&](auto&& value) {
-                            using T = std::decay_t<decltype(value)>;
-                            try {
-                                (void)std::get<T>(*cellValue);
-
-                                typeMismatch = false;
-                            } catch (const std::bad_variant_access& ex) {
-                                typeMismatch = true;
-                            }
-                        }, firstNonNull);
-                    }
-                }
-                catch (...) {
-                    typeMismatch = false;
-                }
-                if (typeMismatch) {
-                    column.add(std::nullopt);
-                }
-                else {
-                    column.add(cellValue);
-                }
-            }
-            else {
-                column.add(std::nullopt);
-            }
+    for(auto& column : this->columns) {
+        const auto& cellValue = row[i];
+        if(cellValue.has_value() && !isTypeMismatch(column, *cellValue)) {
+            column.add(cellValue);
+        }
+        else {
+            column.add(std::nullopt);
         }
         i++;
     }
@@ -165,51 +176,65 @@ void DataFrame::addRow(const std::map<std::string, std::optional<ColumnType>>& r
         throw std::invalid_argument("Row size does not match the number of columns");
     }
 
-    for (auto& colPair : columns) {
-        const std::string& columnName = colPair.first;
-        Column<ColumnType>& column = colPair.second;
-
-        auto it = row.find(columnName);
-        if (it != row.end()) {
-            const auto& cellValue = it->second;
+    for (const auto& [columnName, cellValue] : row) {
+        if (!this->columnIndex.contains(columnName)) {
+            throw std::invalid_argument("Row contains undefined column name: " + columnName);
+        }
+    }
 
-            if (cellValue.has_value()) {
-                bool typeMismatch = false;
+    for (const auto& [columnName, cellValue] : row) {
+        Column<ColumnType>& column = this->columns[this->columnIndex.at(columnName)];
+        if (cellValue.has_value() && !isTypeMismatch(column, *cellValue)) {
+            column.add(cellValue);
+        } else {
+            column.add(std::nullopt);
+        }
+    }
+}
 
-                if (column.getValues().empty()) {
-                    typeMismatch = false;
-                } else {
-                    auto firstNonNull = column.getValues()[0];
+void DataFrame::appendCells(Column<ColumnType>& column, const std::vector<std::optional<ColumnType>>& cells) {
+    column.reserve(column.size() + cells.size());
+    for (const auto& cellValue : cells) {
+        if (cellValue.has_value() && !isTypeMismatch(column, *cellValue)) {
+            column.add(cellValue);
+        } else {
+            column.add(std::nullopt);
+        }
+    }
+}
 
-                    std::visit([&](auto&& value) {
-                        using T = std::decay_t<decltype(value)>;
-                        try {
-                            (void)std::get<T>(*cellValue);
-                            typeMismatch = false;
-                        } catch (const std::bad_variant_access&) {
-                            typeMismatch = true;
-                        }
-                    }, firstNonNull);
-                }
+// Column-major bulk append, batch[i] holds the new cells of the i-th column
+void DataFrame::appendBatch(const std::vector<std::vector<std::optional<ColumnType>>>& batch) {
+    if (batch.size() != this->numberOfColumns()) {
+        throw InvalidNumberOfColumnsException();
+    }
+    for (const auto& cells : batch) {
+        if (cells.size() != batch.front().size()) {
+            throw InvalidSizeException();
+        }
+    }
 
-                if (typeMismatch) {
-                    if (std::holds_alternative<int>(*cellValue) && column.getValues()[0].index() == 0) {
-                        typeMismatch = false;
-                    }
-                }
+    for (size_t i = 0; i < this->columns.size(); ++i) {
+        appendCells(this->columns[i], batch[i]);
+    }
+}
 
-                if (typeMismatch) {
-                    column.add(std::nullopt);
-                } else {
-                    column.add(cellValue);
-                }
-            } else {
-                column.add(std::nullopt);
-            }
-        } else {
-            throw std::invalid_argument("Row contains undefined column name: " + columnName);
+void DataFrame::appendBatch(const std::map<std::string, std::vector<std::optional<ColumnType>>>& batch) {
+    if (batch.size() != this->numberOfColumns()) {
+        throw InvalidNumberOfColumnsException();
+    }
+    for (const auto& [columnName, cells] : batch) {
+        if (!this->columnIndex.contains(columnName)) {
+            throw InvalidNameException();
+        }
+        if (cells.size() != batch.begin()->second.size()) {
+            throw InvalidSizeException();
         }
     }
+
+    for (const auto& [columnName, cells] : batch) {
+        appendCells(this->columns[this->columnIndex.at(columnName)], cells);
+    }
 }
 
 
@@ -218,105 +243,35 @@ void DataFrame::removeRow(size_t index) {
         throw InvalidIndexException();
     }
 
-    for(auto& colPair : this->columns) {
-        auto& col = colPair.second;
+    for(auto& col : this->columns) {
         col.removeAtFromRow(index);
     }
 }
 
 Column<ColumnType> DataFrame::removeColumn(const std::string& columnName) {
-    if(this->columns.find(columnName) == this->columns.end()) {
+    auto it = this->columnIndex.find(columnName);
+    if(it == this->columnIndex.end()) {
         throw InvalidNameException();
     }
-    Column<ColumnType> removedColumn = this->columns.at(columnName);
-    this->columns.erase(columnName);
-
-    auto it = columnIndex.find(columnName);
-    size_t removedIndex = it->second;
-    columnIndex.erase(it);
-
-    for (auto& pair : columnIndex) {
-        if (pair.second > removedIndex) {
-            pair.second--;
-        }
-    }
-    return removedColumn;
+    return this->removeColumn(it->second);
 }
 
+// Only the columns behind the removed one move up a slot
 Column<ColumnType> DataFrame::removeColumn(size_t index) {
     if(index >= this->numberOfColumns()) {
         throw InvalidIndexException();
     }
-    std::string columnName;
-    for (const auto& pair : columnIndex) {
-        if (pair.second == index) {
-            columnName = pair.first;
-            break;
-        }
+    Column<ColumnType> removedColumn = std::move(this->columns[index]);
+    this->columns.erase(this->columns.begin() + static_cast<std::ptrdiff_t>(index));
+    this->columnIndex.erase(removedColumn.getName());
+    for (size_t slot = index; slot < this->columns.size(); ++slot) {
+        this->columnIndex[this->columns[slot].getName()] = slot;
     }
-    return this->removeColumn(columnName);
+    return removedColumn;
 }
 
 void DataFrame::print() const {
-    size_t numRows = columns.begin()->second.size();
-    size_t maxWidthFinal = 0;
-
-    for (const auto& colPair : columns) {
-        const std::string& columnName = colPair.first;
-        const Column<ColumnType>& column = colPair.second;
-
-        size_t maxWidth = columnName.size();
-
-        for (const auto& val : column.getOptionalValues()) {
-            size_t valueWidth = 0;
-
-            if (val.has_value()) {
-                std::visit([&valueWidth](auto&& v) {
-                    std::ostringstream oss;
-                    oss << v;
-                    valueWidth = oss.str().size();
-                }, val.value());
-            } else {
-                valueWidth = std::string("null").size();
-            }
-
-            maxWidth = std::max(maxWidth, valueWidth);
-        }
-
-        maxWidthFinal = std::max(maxWidth, maxWidthFinal);
-    }
-
-    for (const auto& colPair : columns) {
-        const std::string& columnName = colPair.first;
-        std::cout << std::setw(maxWidthFinal) << std::left << columnName << " | ";
-    }
-    std::cout << std::endl;
-
-    for (const auto& colPair : columns) {
-        (void)colPair;
-        std::cout << std::setw(maxWidthFinal) << std::left << std::string(columns.size(), '-') << " | ";
-    }
-    std::cout << std::endl;
-
-    for (size_t i = 0; i < numRows; ++i) {
-        for (const auto& colPair : columns) {
-            (void)colPair;
-            const std::string& columnName = colPair.first;
-            (void)columnName;
-            const Column<ColumnType>& column = colPair.second;
-            const auto& values = column.getOptionalValues();
-            const auto& val = values[i];
-
-            if (val.has_value()) {
-                std::visit([&](auto&& v) {
-                    std::cout << std::setw(maxWidthFinal) << std::left << v << " | ";
-                }, val.value());
-            } else {
-                std::cout << std::setw(maxWidthFinal) << std::left << "null" << " | ";
-            }
-        }
-        std::cout << std::endl;
-    }
+    this->view().print();
 }
 
 
@@ -324,12 +279,12 @@ void DataFrame::print() const {
 DataFrame DataFrame::selectColumns(const std::vector<std::string> &columnNames) {
     DataFrame selectedDf;
     for(const auto& colName : columnNames) {
-        if (this->columns.find(colName) == this->columns.end()) {
+        if (!this->columnIndex.contains(colName)) {
             throw InvalidNameException();
         }
     }
     for(const auto& colName : columnNames) {
-        selectedDf.addColumn(getColumn(colName));
+        selectedDf.addBuffer(colName, this->columns[this->columnIndex.at(colName)].shareBuffer());
     }
     return selectedDf;
 }
@@ -342,81 +297,143 @@ DataFrame DataFrame::selectColumns(const std::vector<size_t> &indexes) {
         }
     }
     for(const auto& idx : indexes) {
-        for (const auto& pair : columnIndex) {
-            if (pair.second == idx) {
-                selectedDf.addColumn(getColumn(pair.first));
-            }
-        }
+        selectedDf.addBuffer(this->columns[idx].getName(), this->columns[idx].shareBuffer());
     }
     return selectedDf;
 }
 
+// Predicates taking a RowView read cells in place, predicates taking the
+// name -> cell map still work but pay for building the map on every row.
 template<typename Predicate>
 DataFrame DataFrame::filterRows(const Predicate& pred) const {
-    DataFrame filteredDf;
+    Bitmask mask(this->numberOfRows(), false);
+    size_t index = 0;
+    for (const RowView& row : this->rows()) {
+        bool keep = false;
+        if constexpr (std::is_invocable_r_v<bool, const Predicate&, const RowView&>) {
+            keep = pred(row);
+        } else {
+            keep = pred(row.toMap());
+        }
+        if (keep) {
+            mask.set(index, true);
+        }
+        index++;
+    }
+    DataFrame filteredDf = this->filter(mask);
+    filteredDf.name = this->name;
+    return filteredDf;
+}
+
+// True when rows picks every row of an n row buffer in order, gathering them
+// would only copy the buffer
+static bool keepsEveryRow(const std::vector<size_t>& rows, size_t n) {
+    if (rows.size() != n) {
+        return false;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (rows[i] != i) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    for (const auto& colPair : this->columns) {
-        const std::string& columnName = colPair.first;
-        filteredDf.addColumn(columnName);
+DataFrame DataFrame::take(const std::vector<size_t>& indices, size_t threads) const {
+    size_t rowCount = this->numberOfRows();
+    for (size_t index : indices) {
+        if (index != NO_ROW && index >= rowCount) {
+            throw InvalidIndexException();
+        }
+    }
+    if (keepsEveryRow(indices, rowCount)) {
+        return *this;
+    }
+    std::vector<std::string> names;
+    std::vector<const ColumnBuffer*> sources;
+    for (const auto& column : this->columns) {
+        names.push_back(column.getName());
+        sources.push_back(&column.getBuffer());
     }
+    std::vector<ColumnBuffer> gathered(sources.size());
+    parallelFor(sources.size(), threads == 0 ? hardwareThreads() : threads, [&](size_t i, size_t) {
+        gathered[i] = sources[i]->gather(indices);
+    });
 
-    size_t numberOfRows = this->numberOfRows();
-    for (size_t rowIdx = 0; rowIdx < numberOfRows; ++rowIdx) {
-        std::map<std::string, std::optional<ColumnType>> rowMapping;
+    DataFrame result;
+    result.name = this->name;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        result.addBuffer(names[i], std::move(gathered[i]));
+    }
+    return result;
+}
 
-        for (const auto& colPair : this->columns) {
-            const std::string& columnName = colPair.first;
-            const Column<ColumnType>& col = colPair.second;
+DataFrame DataFrame::filter(const Bitmask& mask, size_t threads) const {
+    if (mask.size() != this->numberOfRows()) {
+        throw InvalidSizeException();
+    }
+    if (mask.allValid()) {
+        return *this;
+    }
+    // every column is split into row ranges, so all threads help even when
+    // there are fewer columns than threads
+    DataFrame result;
+    result.name = this->name;
+    for (const auto& column : this->columns) {
+        result.addBuffer(column.getName(), column.getBuffer().filter(mask, threads));
+    }
+    return result;
+}
 
-            if (rowIdx < col.size()) {
-                rowMapping[columnName] = col[rowIdx];
-            } else {
-                rowMapping[columnName] = std::nullopt;
-            }
-        }
-        if (pred(rowMapping)) {
-            filteredDf.addRow(rowMapping);
+DataFrame DataFrame::filter(const Condition& condition, size_t threads) const {
+    return this->filter(condition.evaluate(*this, threads), threads);
+}
+
+
+
+// VIEWS
+
+DataFrameView DataFrame::view() const {
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<const ColumnBuffer>> buffers;
+    for (const auto& column : this->columns) {
+        names.push_back(column.getName());
+        buffers.push_back(column.shareBuffer());
+    }
+    return DataFrameView(std::move(names), std::move(buffers), 0, this->numberOfRows());
+}
+
+DataFrameView DataFrame::view(const std::vector<std::string>& columnNames) const {
+    std::vector<std::shared_ptr<const ColumnBuffer>> buffers;
+    for (const auto& columnName : columnNames) {
+        auto it = this->columnIndex.find(columnName);
+        if (it == this->columnIndex.end()) {
+            throw std::runtime_error("Column not found");
         }
+        buffers.push_back(this->columns[it->second].shareBuffer());
     }
-    return filteredDf;
+    return DataFrameView(columnNames, std::move(buffers), 0, this->numberOfRows());
+}
+
+DataFrameView DataFrame::head(size_t n) const {
+    return this->view().head(n);
+}
+
+DataFrameView DataFrame::tail(size_t n) const {
+    return this->view().tail(n);
+}
+
+DataFrameView DataFrame::slice(size_t offset, size_t length) const {
+    return this->view().slice(offset, length);
 }
 
 
 
 // STATISTICS
 
+// min, max, mean, std, var and countNull share one fused pass per column
 std::map<std::string, std::map<std::string, ColumnType>> DataFrame::aggregate(const std::vector<std::string>& operations) const {
-    std::map<std::string, std::map<std::string, ColumnType>> results;
-    for (const auto& [colName, column] : columns) {
-        std::map<std::string, ColumnType> columnResults;
-        for (const auto& op : operations) {
-            if (op == "min") {
-                columnResults["min"] = std::visit([](const auto& value) -> ColumnType {
-                    return value;
-                }, column.min());
-            } else if (op == "max") {
-                columnResults["max"] = std::visit([](const auto& value) -> ColumnType {
-                    return value;
-                }, column.max());
-            } else if (op == "mean") {
-                columnResults["mean"] = column.mean();
-            } else if (op == "std") {
-                columnResults["std"] = column.std();
-            } else if (op == "var") {
-                columnResults["var"] = column.var();
-            } else if (op == "countNull") {
-                columnResults["countNull"] = column.countNull();
-            } else if (op == "nunique") {
-                columnResults["nunique"] = column.countDistinct();
-            } else if (op == "median") {
-                columnResults["median"] = column.median();
-            } else {
-                throw std::invalid_argument("Unsupported operation: " + op);
-            }
-        }
-        results[colName] = columnResults;
-    }
-    return results;
+    return this->view().aggregate(operations);
 }
 
 std::map<std::string, std::map<std::string, ColumnType>> DataFrame::describe() const {
@@ -450,8 +467,8 @@ std::map<std::string, std::map<std::string, ColumnType>> DataFrame::median() con
 // NULL-HANDLING
 
 void DataFrame::fillNullWithDefault() {
-    for(auto& colPair : this->columns) {
-        colPair.second.fillNull();
+    for(auto& column : this->columns) {
+        column.fillNull();
     }
 }
 
@@ -460,55 +477,78 @@ void DataFrame::fillNull(std::vector<ColumnType> &values) {
         throw InvalidSizeException();
     }
     int i = 0;
-    for(auto& colPair : this->columns) {
-        colPair.second.fillNull(values[i]);
+    for(auto& column : this->columns) {
+        column.fillNull(values[i]);
         i++;
     }
 }
 
 // SORTING
 
+// Nulls stay after the values in ascending order and before them in descending order
 DataFrame DataFrame::sortBy(const std::string &columnName, bool ascending) const {
-    auto colIter = columns.find(columnName);
-    if (colIter == columns.end()) {
-        throw std::invalid_argument("Column " + columnName + " does not exist in the DataFrame.");
-    }
-    const auto& sortColumn = colIter->second;
-    size_t nRows = numberOfRows();
+    return this->sortBy(std::vector<std::string>{columnName}, std::vector<bool>{ascending}, !ascending);
+}
 
-    std::vector<size_t> rowIndices(nRows);
-    for (size_t i = 0; i < nRows; ++i) {
-        rowIndices[i] = i;
+DataFrame DataFrame::sortBy(const std::vector<std::string>& columnNames, const std::vector<bool>& ascending, bool nullsFirst,
+                            size_t threads) const {
+    if (!ascending.empty() && ascending.size() != columnNames.size()) {
+        throw std::invalid_argument("sortBy needs one ascending flag per column");
     }
-
-    std::sort(rowIndices.begin(), rowIndices.end(), [&](size_t i, size_t j) {
-        const auto& valueA = sortColumn[i];
-        const auto& valueB = sortColumn[j];
-        if (!valueA.has_value() || !valueB.has_value()) {
-            return ascending ? valueA.has_value() : valueB.has_value();
+    std::vector<const ColumnBuffer*> keys;
+    for (const auto& columnName : columnNames) {
+        auto colIter = this->columnIndex.find(columnName);
+        if (colIter == this->columnIndex.end()) {
+            throw std::invalid_argument("Column " + columnName + " does not exist in the DataFrame.");
         }
-        if (ascending) {
-            return valueA < valueB;
-        } else {
-            return valueA > valueB;
-        }
-    });
-
-    DataFrame sortedDf;
-    sortedDf.name = this->name;
-    for (const auto& [colName, column] : columns) {
-        Column<ColumnType> sortedColumn(column.getName());
-        for (size_t index : rowIndices) {
-            sortedColumn.add(column[index]);
-        }
-        sortedDf.columns[colName] = sortedColumn;
+        keys.push_back(&this->columns[colIter->second].getBuffer());
     }
+    threads = threads == 0 ? hardwareThreads() : threads;
+    std::vector<size_t> rowIndices = sortPermutation(keys, ascending.empty() ? std::vector<bool>(keys.size(), true) : ascending,
+                                                     nullsFirst, threads);
+
+    return this->take(rowIndices, threads);
+}
+
+DataFrame DataFrame::sortBy(std::initializer_list<std::string> columnNames, std::initializer_list<bool> ascending, bool nullsFirst,
+                            size_t threads) const {
+    return this->sortBy(std::vector<std::string>(columnNames), std::vector<bool>(ascending), nullsFirst, threads);
+}
+
+DataFrame DataFrame::nlargest(size_t n, const std::vector<std::string>& columnNames, size_t threads) const {
+    threads = threads == 0 ? hardwareThreads() : threads;
+    return this->take(topRows(this->keyBuffers(columnNames), n, true, threads), threads);
+}
 
-    return sortedDf;
+DataFrame DataFrame::nsmallest(size_t n, const std::vector<std::string>& columnNames, size_t threads) const {
+    threads = threads == 0 ? hardwareThreads() : threads;
+    return this->take(topRows(this->keyBuffers(columnNames), n, false, threads), threads);
 }
 
 // FILES
 
+// Same inference as std::stod falling back to a string: any cell with a numeric
+// prefix is a double. strtod reports failure without throwing, which keeps
+// text columns from paying for an exception per cell.
+std::optional<ColumnType> DataFrame::parseCell(const std::string& cell) {
+    if (cell.empty()) {
+        return std::nullopt;
+    }
+    char* end = nullptr;
+    double doubleVal = std::strtod(cell.c_str(), &end);
+    if (end != cell.c_str()) {
+        return doubleVal;
+    }
+    return cell;
+}
+
+// Low-cardinality string columns read from files end up dictionary encoded
+void DataFrame::enableAutoDictionary() {
+    for (auto& column : this->columns) {
+        column.setAutoDictionary(true);
+    }
+}
+
 DataFrame DataFrame::readCSV(const std::string &filePath, const std::string& separator, bool hasHeaderLine) {
     std::ifstream file(filePath);
     if (!file.is_open()) {
@@ -516,7 +556,6 @@ DataFrame DataFrame::readCSV(const std::string &filePath, const std::string& sep
     }
 
     DataFrame df;
-    std::vector<std::string> columnNames;
 
     if (hasHeaderLine) {
         std::string headerLine;
@@ -525,9 +564,9 @@ DataFrame DataFrame::readCSV(const std::string &filePath, const std::string& sep
 
         std::string columnName;
         while (std::getline(headerStream, columnName, separator[0])) {
-            columnNames.push_back(columnName);
             df.addColumn(columnName);
         }
+        df.enableAutoDictionary();
     } else {
         std::string firstLine;
         if (std::getline(file, firstLine)) {
@@ -545,31 +584,11 @@ DataFrame DataFrame::readCSV(const std::string &filePath, const std::string& sep
             size_t colIndex = 0;
             while(std::getline(rowStream, cell, separator[0])) {
                 if (colIndex < df.numberOfColumns()) {
-                    if(cell.empty()) {
-                        rowValues[inferredColumnCount] = std::nullopt;
-                    }
-                    else {
-                        try {
-                            double doubleVal = std::stod(cell);
-                            rowValues[colIndex] = doubleVal;
-                        } catch (...) {
-                            try {
-                                int intVal = std::stoi(cell);
-                                rowValues[colIndex] = intVal;
-                            } catch (...) {
-                                try {
-                                    bool boolVal = (bool)std::stoi(cell);
-                                    rowValues[colIndex] = boolVal;
-                                }
-                                catch (...) {
-                                    rowValues[colIndex] = cell;
-                                }
-                            }
-                        }
-                    }
+                    rowValues[colIndex] = parseCell(cell);
                 }
                 ++colIndex;
             }
+            df.enableAutoDictionary();
             df.addRow(rowValues);
         }
     }
@@ -578,34 +597,13 @@ DataFrame DataFrame::readCSV(const std::string &filePath, const std::string& sep
     while (std::getline(file, rowLine)) {
         std::stringstream rowStream(rowLine);
         std::string cell;
-        std::map<std::string, std::optional<ColumnType>> rowValues;
+        // columns keep the order of the file, so cells go in by position
+        std::vector<std::optional<ColumnType>> rowValues;
+        rowValues.reserve(df.numberOfColumns());
 
-        size_t colIndex = 0;
         while (std::getline(rowStream, cell, separator[0])) {
-            if (colIndex < columnNames.size()) {
-                const std::string& columnName = columnNames[colIndex];
-
-                if (cell.empty()) {
-                    rowValues[columnName] = std::nullopt;
-                } else {
-                    try {
-                        double doubleVal = std::stod(cell);
-                        rowValues[columnName] = doubleVal;
-                    } catch (...) {
-                        try {
-                            int intVal = std::stoi(cell);
-                            rowValues[columnName] = intVal;
-                        } catch (...) {
-                            try {
-                                bool boolVal = (bool)std::stoi(cell);
-                                rowValues[columnName] = boolVal;
-                            } catch (...) {
-                                rowValues[columnName] = cell;
-                            }
-                        }
-                    }
-                }
-                ++colIndex;
+            if (rowValues.size() < df.numberOfColumns()) {
+                rowValues.push_back(parseCell(cell));
             }
         }
 
@@ -618,191 +616,319 @@ DataFrame DataFrame::readCSV(const std::string &filePath, const std::string& sep
 
 
 void DataFrame::saveCSV(const std::string &filePath, const std::string &separator, bool saveHeaderLine) {
-    std::ofstream file(filePath);
-    if(!file.is_open()) {
-        throw std::runtime_error("Could not open the file: " + filePath);
-    }
+    this->view().saveCSV(filePath, separator, saveHeaderLine);
+}
 
-    if(saveHeaderLine) {
-        size_t cnt = 0;
-        for(const auto& pair : columns) {
-            file << pair.first;
-            cnt++;
-            if(cnt < columns.size()) {
-                file << separator;
+void DataFrame::filterColumn(const std::string& columnName, std::function<bool(const ColumnType&)> predicate) {
+    if (this->columnIndex.contains(columnName)) {
+        Column<ColumnType>& column = this->columns[this->columnIndex.at(columnName)];
+        const ColumnBuffer& buffer = column.getBuffer();
+        Bitmask mask(buffer.size(), false);
+        buffer.getValidity().forEachSet([&](size_t row) {
+            if (predicate(*buffer.get(row))) {
+                mask.set(row, true);
             }
+        });
+        column.where(mask);
+    } else {
+        std::cerr << "Column " << columnName << " does not exist!" << std::endl;
+    }
+}
+
+void DataFrame::filterColumn(const std::string& columnName, const Condition& condition, size_t threads) {
+    this->filterColumns({columnName}, condition.evaluate(*this, threads), threads);
+}
+
+void DataFrame::filterColumns(const std::vector<std::string>& columnNames, const Bitmask& mask, size_t threads) {
+    if (mask.size() != this->numberOfRows()) {
+        throw InvalidSizeException();
+    }
+    std::vector<Column<ColumnType>*> targets;
+    for (const auto& columnName : columnNames) {
+        auto it = this->columnIndex.find(columnName);
+        if (it == this->columnIndex.end()) {
+            throw std::runtime_error("Column not found");
         }
-        file << "\n";
+        targets.push_back(&this->columns[it->second]);
     }
+    // a column listed twice must not be masked by two threads at once
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+    parallelFor(targets.size(), threads == 0 ? hardwareThreads() : threads, [&](size_t i, size_t) {
+        targets[i]->where(mask);
+    });
+}
 
-    for(size_t i = 0; i < this->numberOfRows(); i++) {
-        size_t cnt = 0;
-        for(const auto& pair : columns) {
-            auto column = pair.second;
-            if(column[i].has_value()) {
-                std::visit([&file](auto&& val) { file << val; }, column[i].value());
-            }
-            cnt++;
-            if(cnt < columns.size()) {
-                file << separator;
-            }
+// ROW ACCESS
+
+std::optional<ColumnType> RowView::operator[](const std::string& columnName) const {
+    for (size_t position = 0; position < this->layout->names.size(); ++position) {
+        if (this->layout->names[position] == columnName) {
+            return (*this)[position];
         }
-        file << "\n";
     }
-    file.close();
+    throw InvalidNameException();
 }
 
-void DataFrame::filterColumn(const std::string& columnName, std::function<bool(const ColumnType&)> predicate) {
-    if (columns.find(columnName) != columns.end()) {
-        Column<std::variant<int, double, bool, std::string>>& column = columns[columnName];
-
-        for (auto& cell : column.getOptionalValues()) {
-            if (cell.has_value()) {
-                bool shouldKeep = std::visit([&](auto&& value) {
-                    using T = std::decay_t<decltype(value)>;
-                    if constexpr (std::is_same_v<T, ColumnType>) {
-                        return predicate(value);
-                    } else {
-                        return true;
-                    }
-                }, cell.value());
-
-                if (!shouldKeep) {
-                    cell = std::nullopt;
-                }
-            }
+template<class T>
+std::optional<T> RowView::get(const std::string& columnName) const {
+    std::optional<ColumnType> cell = (*this)[columnName];
+    if (!cell.has_value() || !std::holds_alternative<T>(*cell)) {
+        return std::nullopt;
+    }
+    return std::get<T>(*cell);
+}
+
+std::vector<std::optional<ColumnType>> RowView::toVector() const {
+    std::vector<std::optional<ColumnType>> cells;
+    cells.reserve(this->size());
+    for (size_t position = 0; position < this->size(); ++position) {
+        cells.push_back((*this)[position]);
+    }
+    return cells;
+}
+
+std::map<std::string, std::optional<ColumnType>> RowView::toMap() const {
+    std::map<std::string, std::optional<ColumnType>> cells;
+    for (size_t position = 0; position < this->size(); ++position) {
+        cells.emplace(this->layout->names[position], (*this)[position]);
+    }
+    return cells;
+}
+
+RowView RowRange::operator[](size_t index) const {
+    if (index >= this->numberOfRows) {
+        throw InvalidIndexException();
+    }
+    return RowView(this->layout.get(), index);
+}
+
+RowRange DataFrame::rows() const {
+    auto layout = std::make_shared<RowLayout>();
+    for (const auto& column : this->columns) {
+        layout->names.push_back(column.getName());
+        layout->buffers.push_back(&column.getBuffer());
+    }
+    return RowRange(layout, this->numberOfRows());
+}
+
+RowRange DataFrame::rowsExcept(const std::string& columnName) const {
+    auto layout = std::make_shared<RowLayout>();
+    for (const auto& column : this->columns) {
+        if (column.getName() != columnName) {
+            layout->names.push_back(column.getName());
+            layout->buffers.push_back(&column.getBuffer());
         }
-    } else {
-        std::cerr << "Column " << columnName << " does not exist!" << std::endl;
     }
+    return RowRange(layout, this->numberOfRows());
 }
 
 std::vector<std::optional<ColumnType>> DataFrame::getRow(size_t index) const {
     std::vector<std::optional<ColumnType>> row;
-    for (const auto& columnPair : this->columns) {
-        row.push_back(columnPair.second.getOptionalValues()[index]);
+    for (const auto& column : this->columns) {
+        row.push_back(column[index]);
     }
     return row;
 }
 
 std::vector<std::optional<ColumnType>> DataFrame::getRowWithoutGroupByColumn(size_t index, const std::string& columnName) const {
     std::vector<std::optional<ColumnType>> row;
-    for (const auto& columnPair : this->columns) {
-        if(columnPair.first != columnName) {
-            row.push_back(columnPair.second.getOptionalValues()[index]);
+    for (const auto& column : this->columns) {
+        if(column.getName() != columnName) {
+            row.push_back(column[index]);
         }
     }
     return row;
 }
 
 DataFrame DataFrame::groupBy(const std::string &columnName, const std::string &aggregation) {
-    std::map<ColumnType, std::vector<std::vector<std::optional<ColumnType>>>> groups;
-    const Column<ColumnType>& groupColumn = columns.at(columnName);
-    size_t numRows = groupColumn.size();
-
-    for (size_t i = 0; i < numRows; ++i) {
-        if (groupColumn.getOptionalValues()[i].has_value()) {
-            ColumnType groupValue = groupColumn.getOptionalValues()[i].value();
-            groups[groupValue].push_back(getRowWithoutGroupByColumn(i, columnName));
+    const Column<ColumnType>& groupColumn = this->getColumn(columnName);
+    AggregationOp op = parseAggregation(aggregation);
+
+    std::vector<std::pair<const ColumnBuffer*, AggregationOp>> specs;
+    std::vector<std::string> valueColumns;
+    for (const auto& column : this->columns) {
+        if (column.getName() != columnName) {
+            specs.emplace_back(&column.getBuffer(), op);
+            valueColumns.push_back(column.getName());
         }
     }
 
-    DataFrame result(*this, columnName);
+    HashAggregation hashAggregation({&groupColumn.getBuffer()}, specs);
+    hashAggregation.consume(0, this->numberOfRows());
+    std::vector<uint32_t> groupOrder = hashAggregation.groupOrder(true);
 
-    for(const auto& group : groups) {
-        std::vector<std::optional<ColumnType>> aggregatedRow;
-            if(aggregation == "sum") {
-                std::vector<double> sums = aggregateSum(group.second);
-                for (auto sum : sums) {
-                    aggregatedRow.push_back(std::make_optional<ColumnType>(sum));
-                }
-            }
-            if(aggregation == "count") {
-                std::vector<double> counts = aggregateCount(group.second);
-                for (auto count : counts) {
-                    aggregatedRow.push_back(std::make_optional<ColumnType>(count));
-                }
-            }
-            if(aggregation == "mean") {
-                std::vector<double> means = aggregateMean(group.second);
-                for (auto mean : means) {
-                    aggregatedRow.push_back(std::make_optional<ColumnType>(mean));
-                }
-            }
-        result.addRow(aggregatedRow);
+    DataFrame result;
+    for (size_t i = 0; i < valueColumns.size(); ++i) {
+        Column<ColumnType> aggregated(valueColumns[i], hashAggregation.result(i, groupOrder));
+        if (op == AggregationOp::Mean) {
+            // groups without values report a mean of 0
+            aggregated.fillNull(0.0);
+        }
+        result.addColumn(aggregated);
     }
-
     return result;
 }
 
-std::vector<double> DataFrame::aggregateSum(const std::vector<std::vector<std::optional<ColumnType>>>& groupRows) const {
-    size_t numColumns = groupRows[0].size();
-    std::vector<double> sum(numColumns, 0.0);
-
-    for (const auto& row : groupRows) {
-        for (size_t i = 0; i < row.size(); ++i) {
-            const auto& cell = row[i];
-            if (cell.has_value()) {
-                sum[i] += std::visit([](const auto& value) -> double {
-                    if constexpr (std::is_arithmetic_v<std::decay_t<decltype(value)>>) {
-                        return static_cast<double>(value);
-                    }
-                    return std::nan("");
-                }, cell.value());
-            }
+GroupBy DataFrame::groupBy(const std::vector<std::string>& keys, bool sortGroups) const {
+    for (const auto& key : keys) {
+        if (this->columnIndex.find(key) == this->columnIndex.end()) {
+            throw std::runtime_error("Column not found");
         }
     }
-    return sum;
+    return GroupBy(this->view(), keys, sortGroups);
 }
 
-std::vector<double> DataFrame::aggregateCount(const std::vector<std::vector<std::optional<ColumnType>>>& groupRows) const {
-    size_t numColumns = groupRows[0].size();
-    std::vector<double> counts(numColumns, 0.0);
+GroupBy& GroupBy::parallel(size_t numberOfThreads) {
+    this->threads = numberOfThreads == 0 ? hardwareThreads() : numberOfThreads;
+    return *this;
+}
 
-    for (size_t rowIndex = 0; rowIndex < groupRows.size(); ++rowIndex) {
-        const auto& row = groupRows[rowIndex];
-        for (const auto& cell : row) {
-            if (cell.has_value()) {
-                counts[rowIndex] += 1.0;
-            }
+DataFrame GroupBy::agg(const std::vector<std::pair<std::string, std::string>>& aggregations) const {
+    std::vector<const ColumnBuffer*> keyBuffers;
+    for (const auto& key : this->keys) {
+        keyBuffers.push_back(this->source.buffers[this->source.position(key)].get());
+    }
+    std::vector<std::pair<const ColumnBuffer*, AggregationOp>> specs;
+    for (const auto& [columnName, op] : aggregations) {
+        specs.emplace_back(this->source.buffers[this->source.position(columnName)].get(), parseAggregation(op));
+    }
+
+    HashAggregation hashAggregation(keyBuffers, specs);
+    size_t begin = this->source.offset;
+    hashAggregation.consumeParallel(begin, begin + this->source.numberOfRows(), this->threads);
+    std::vector<uint32_t> groupOrder = hashAggregation.groupOrder(this->sortGroups);
+
+    DataFrame result;
+    for (size_t i = 0; i < this->keys.size(); ++i) {
+        result.addColumn(Column<ColumnType>(this->keys[i], hashAggregation.keyColumn(i, groupOrder)));
+    }
+    for (size_t i = 0; i < aggregations.size(); ++i) {
+        std::string resultName = aggregations[i].first + "_" + aggregationName(specs[i].second);
+        result.addColumn(Column<ColumnType>(resultName, hashAggregation.result(i, groupOrder)));
+    }
+    return result;
+}
+
+// JOINS
+
+std::vector<const ColumnBuffer*> DataFrame::keyBuffers(const std::vector<std::string>& keys) const {
+    std::vector<const ColumnBuffer*> buffers;
+    for (const auto& key : keys) {
+        if (this->columnIndex.find(key) == this->columnIndex.end()) {
+            throw std::runtime_error("Column not found");
         }
+        buffers.push_back(&this->columns[this->columnIndex.at(key)].getBuffer());
     }
-    return counts;
+    return buffers;
 }
 
-std::vector<double> DataFrame::aggregateMean(const std::vector<std::vector<std::optional<ColumnType>>>& groupRows) const {
-    if (groupRows.empty() || groupRows[0].empty()) {
+// Rows in ascending key order, empty when the frame already is in that order
+std::vector<size_t> DataFrame::ascendingOrder(const std::vector<std::string>& keys, bool assumeSorted) const {
+    std::vector<const ColumnBuffer*> buffers = this->keyBuffers(keys);
+    std::vector<bool> ascending(keys.size(), true);
+    if (assumeSorted || isSorted(buffers, ascending)) {
         return {};
     }
+    return sortPermutation(buffers, ascending);
+}
 
-    size_t numColumns = groupRows[0].size();
-    std::vector<double> means(numColumns, 0.0);
-    std::vector<size_t> counts(numColumns, 0);
-
-    for (const auto& row : groupRows) {
-        for (size_t colIndex = 0; colIndex < numColumns; ++colIndex) {
-            const auto& cell = row[colIndex];
-            if (cell.has_value()) {
-                means[colIndex] += std::visit([](const auto& value) -> double {
-                    if constexpr (std::is_arithmetic_v<std::decay_t<decltype(value)>>) {
-                        return static_cast<double>(value);
-                    }
-                    return std::nan("");
-                }, cell.value());
-                ++counts[colIndex];
+// Output holds every left column, then the right columns unless they are listed
+// in droppedRightColumns. Right names already taken get a "_right" suffix.
+DataFrame DataFrame::joinedFrame(const DataFrame& other, const JoinIndices& indices, bool includeRight,
+                                 const std::vector<std::string>& droppedRightColumns, size_t threads) const {
+    std::vector<std::string> outputNames;
+    std::vector<std::pair<const Column<ColumnType>*, const std::vector<size_t>*>> sources;
+    for (const auto& column : this->columns) {
+        outputNames.push_back(column.getName());
+        sources.emplace_back(&column, &indices.leftRows);
+    }
+    if (includeRight) {
+        for (const auto& column : other.columns) {
+            const std::string colName = column.getName();
+            if (std::find(droppedRightColumns.begin(), droppedRightColumns.end(), colName) != droppedRightColumns.end()) {
+                continue;
             }
+            outputNames.push_back(this->columnIndex.contains(colName) ? colName + "_right" : colName);
+            sources.emplace_back(&column, &indices.rightRows);
         }
     }
 
-    for (size_t colIndex = 0; colIndex < numColumns; ++colIndex) {
-        if (counts[colIndex] > 0) {
-            means[colIndex] /= static_cast<double>(counts[colIndex]);
+    // A side whose rows all come out once and in order keeps its buffers
+    bool keepsLeft = keepsEveryRow(indices.leftRows, this->numberOfRows());
+    bool keepsRight = keepsEveryRow(indices.rightRows, other.numberOfRows());
+    auto shared = [&](size_t i) {
+        return sources[i].second == &indices.leftRows ? keepsLeft : keepsRight;
+    };
+    std::vector<ColumnBuffer> gathered(sources.size());
+    parallelFor(sources.size(), threads, [&](size_t i, size_t) {
+        if (!shared(i)) {
+            gathered[i] = sources[i].first->getBuffer().gather(*sources[i].second);
+        }
+    });
+    DataFrame result;
+    for (size_t i = 0; i < gathered.size(); ++i) {
+        if (shared(i)) {
+            result.addBuffer(outputNames[i], sources[i].first->shareBuffer());
         } else {
-            means[colIndex] = 0.0;
+            result.addBuffer(outputNames[i], std::move(gathered[i]));
         }
     }
+    return result;
+}
 
-    return means;
+// Right keys with the same name as their left key are not repeated in the output
+static std::vector<std::string> sharedKeys(const std::vector<std::string>& leftKeys, const std::vector<std::string>& rightKeys) {
+    std::vector<std::string> shared;
+    for (size_t i = 0; i < leftKeys.size() && i < rightKeys.size(); ++i) {
+        if (leftKeys[i] == rightKeys[i]) shared.push_back(rightKeys[i]);
+    }
+    return shared;
+}
+
+DataFrame DataFrame::join(const DataFrame& other, const std::vector<std::string>& leftKeys, const std::vector<std::string>& rightKeys,
+                          const std::string& how, size_t threads) const {
+    JoinType type = parseJoinType(how);
+    threads = threads == 0 ? hardwareThreads() : threads;
+    JoinIndices indices = hashJoin(this->keyBuffers(leftKeys), other.keyBuffers(rightKeys), type, threads);
+    bool includeRight = type == JoinType::Inner || type == JoinType::Left;
+    return this->joinedFrame(other, indices, includeRight, sharedKeys(leftKeys, rightKeys), threads);
+}
+
+DataFrame DataFrame::mergeJoin(const DataFrame& other, const std::vector<std::string>& leftKeys, const std::vector<std::string>& rightKeys,
+                               const std::string& how, bool assumeSorted) const {
+    JoinType type = parseJoinType(how);
+    JoinIndices indices = ::mergeJoin(this->keyBuffers(leftKeys), other.keyBuffers(rightKeys), type,
+                                      this->ascendingOrder(leftKeys, assumeSorted), other.ascendingOrder(rightKeys, assumeSorted));
+    bool includeRight = type == JoinType::Inner || type == JoinType::Left;
+    return this->joinedFrame(other, indices, includeRight, sharedKeys(leftKeys, rightKeys), 1);
+}
+
+DataFrame DataFrame::asofJoin(const DataFrame& other, const std::string& on, const std::vector<std::string>& by,
+                              std::optional<double> tolerance, bool assumeSorted) const {
+    // rows have to be ordered by the by columns first and by on last; a frame
+    // declared sorted by on only needs a stable sort by the by columns
+    std::vector<std::string> orderKeys = by;
+    if (!assumeSorted) {
+        orderKeys.push_back(on);
+    }
+    std::vector<size_t> leftOrder;
+    std::vector<size_t> rightOrder;
+    if (!orderKeys.empty()) {
+        leftOrder = this->ascendingOrder(orderKeys, false);
+        rightOrder = other.ascendingOrder(orderKeys, false);
+    }
+
+    std::vector<const ColumnBuffer*> leftBy = this->keyBuffers(by);
+    JoinIndices indices;
+    indices.rightRows = asofMatches(*this->keyBuffers({on}).front(), *other.keyBuffers({on}).front(),
+                                    leftBy, other.keyBuffers(by), tolerance, leftOrder, rightOrder);
+    indices.leftRows.resize(this->numberOfRows());
+    std::iota(indices.leftRows.begin(), indices.leftRows.end(), 0);
+
+    std::vector<std::string> dropped = by;
+    dropped.push_back(on);
+    return this->joinedFrame(other, indices, true, dropped, 1);
 }
 
 int main() {
@@ -836,11 +962,11 @@ int main() {
     std::cout << "Mean value: " << intColumn.mean() << std::endl;
     std::cout << "Median: " << intColumn.median() << std::endl;
 
-    auto multipliedColumn = intColumn * 2;
+    Column<int> multipliedColumn = intColumn * 2;
     std::cout << "\nColumn after multiplying by 2:" << std::endl;
     multipliedColumn.print();
 
-    auto dividedColumn = intColumn / 5;
+    Column<int> dividedColumn = intColumn / 5;
     std::cout << "\nColumn after dividing by 5:" << std::endl;
     dividedColumn.print();
 
@@ -850,6 +976,12 @@ int main() {
     std::cout << "\nColumn after filtering (values >= 30):" << std::endl;
     filteredColumn.print();
 
+    std::cout << "\nThree largest values:" << std::endl;
+    intColumn.topK(3).print();
+
+    std::cout << "\nThree smallest values:" << std::endl;
+    intColumn.topK(3, false).print();
+
     Column<std::string> stringColumn("Names", {"Alice", "Bob", "Charlie", "Diana", "Eve"});
     std::cout << "\nString Column: " << stringColumn.getName() << std::endl;
     stringColumn.print();
@@ -925,6 +1057,12 @@ int main() {
     auto sortedDf = df.sortBy("int", true);
     sortedDf.print();
 
+    std::cout << "\nTwo rows with the largest 'double' values:" << std::endl;
+    df.nlargest(2, {"double"}).print();
+
+    std::cout << "\nTwo rows with the smallest 'double' values:" << std::endl;
+    df.nsmallest(2, {"double"}).print();
+
     std::cout << "\nFilter Rows where 'double' column > 15.0:" << std::endl;
     auto filteredDf = df.filterRows([&](const std::map<std::string, std::optional<ColumnType>>& rowMapping) {
         if (rowMapping.at("double").has_value()) {
@@ -0,0 +1,26 @@
+#include "../include/expression.h"
+#include "../include/column.h"
+#include <vector>
+
+template<class Op, ColumnExpression Left, ColumnExpression Right>
+Column<typename BinaryExpression<Op, Left, Right>::value_type> BinaryExpression<Op, Left, Right>::evaluate() const {
+    size_t n = this->size();
+    // one branch free pass over all rows, null rows are computed and then reset
+    std::vector<value_type> data(n);
+    value_type* out = data.data();
+    for (size_t i = 0; i < n; i++) {
+        out[i] = this->value(i);
+    }
+    std::vector<uint64_t> words((n + 63) >> 6);
+    for (size_t w = 0; w < words.size(); w++) {
+        words[w] = this->validWord(w);
+        uint64_t nulls = ~words[w];
+        if (((w + 1) << 6) > n) {
+            nulls &= (1ULL << (n & 63)) - 1;
+        }
+        for (; nulls != 0; nulls &= nulls - 1) {
+            out[(w << 6) + static_cast<size_t>(std::countr_zero(nulls))] = value_type();
+        }
+    }
+    return Column<value_type>(this->name(), ColumnBuffer(std::move(data), ValidityBitmap(std::move(words), n)));
+}
@@ -0,0 +1,546 @@
+#include "../include/groupby.h"
+#include "../include/parallel.h"
+#include <bit>
+#include <cmath>
+#include <numeric>
+
+AggregationOp parseAggregation(const std::string& name) {
+    if (name == "sum") return AggregationOp::Sum;
+    if (name == "count") return AggregationOp::Count;
+    if (name == "mean") return AggregationOp::Mean;
+    if (name == "min") return AggregationOp::Min;
+    if (name == "max") return AggregationOp::Max;
+    if (name == "approx_count_distinct") return AggregationOp::ApproxCountDistinct;
+    throw std::invalid_argument("Unsupported aggregation: " + name);
+}
+
+std::string aggregationName(AggregationOp op) {
+    switch (op) {
+        case AggregationOp::Sum: return "sum";
+        case AggregationOp::Count: return "count";
+        case AggregationOp::Mean: return "mean";
+        case AggregationOp::Min: return "min";
+        case AggregationOp::Max: return "max";
+        default: return "approx_count_distinct";
+    }
+}
+
+// Doubles are hashed by bit pattern, so all zeros and all NaNs must share one
+static uint64_t normalizedBits(double value) {
+    if (value == 0.0) {
+        return 0;
+    }
+    if (std::isnan(value)) {
+        return std::bit_cast<uint64_t>(std::numeric_limits<double>::quiet_NaN());
+    }
+    return std::bit_cast<uint64_t>(value);
+}
+
+// Hash of the key of one row over all key columns, equal keys hash equal
+static uint64_t keyHash(const std::vector<const ColumnBuffer*>& keyBuffers, size_t row) {
+    uint64_t hash = 0;
+    for (const ColumnBuffer* buffer : keyBuffers) {
+        uint64_t value = buffer->visit([row](const auto& data) -> uint64_t {
+            using Storage = std::decay_t<decltype(data)>;
+            if constexpr (std::is_same_v<Storage, std::vector<double>>) {
+                return normalizedBits(data[row]);
+            } else if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+                return data.getCodes()[row];
+            } else if constexpr (std::is_same_v<Storage, std::vector<std::string>>) {
+                return std::hash<std::string_view>()(data[row]);
+            } else if constexpr (std::is_same_v<Storage, std::monostate>) {
+                return 0;
+            } else {
+                return static_cast<uint64_t>(data[row]);
+            }
+        });
+        hash = (hash ^ value) * 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+// Strict ordering of two non-null cells of the same buffer
+static bool rowLess(const ColumnBuffer& buffer, size_t a, size_t b) {
+    return buffer.visit([a, b](const auto& data) {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (std::is_same_v<Storage, std::monostate>) {
+            return false;
+        } else {
+            return data[a] < data[b];
+        }
+    });
+}
+
+// KEY ENCODER
+
+KeyEncoder::KeyEncoder(const ColumnBuffer& buffer) : buffer(&buffer) {
+    if (buffer.kind() == ColumnKind::Dictionary) {
+        this->codeIds.assign(buffer.getDictionary().cardinality(), NULL_GROUP);
+    } else if (buffer.kind() == ColumnKind::Bool) {
+        this->codeIds.assign(2, NULL_GROUP);
+    }
+}
+
+uint32_t KeyEncoder::newId(size_t row) {
+    this->firstRows.push_back(row);
+    return static_cast<uint32_t>(this->firstRows.size() - 1);
+}
+
+uint32_t KeyEncoder::encodeRow(size_t row) {
+    if (!this->buffer->isValid(row)) {
+        return NULL_GROUP;
+    }
+    return this->buffer->visit([this, row](const auto& data) -> uint32_t {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (std::is_same_v<Storage, std::vector<int>>) {
+            auto [it, inserted] = this->intIds.try_emplace(data[row], 0);
+            if (inserted) it->second = this->newId(row);
+            return it->second;
+        } else if constexpr (std::is_same_v<Storage, std::vector<double>>) {
+            auto [it, inserted] = this->doubleIds.try_emplace(normalizedBits(data[row]), 0);
+            if (inserted) it->second = this->newId(row);
+            return it->second;
+        } else if constexpr (std::is_same_v<Storage, std::vector<bool>>) {
+            uint32_t& id = this->codeIds[data[row] ? 1 : 0];
+            if (id == NULL_GROUP) id = this->newId(row);
+            return id;
+        } else if constexpr (std::is_same_v<Storage, std::vector<std::string>>) {
+            auto [it, inserted] = this->stringIds.try_emplace(std::string_view(data[row]), 0);
+            if (inserted) it->second = this->newId(row);
+            return it->second;
+        } else if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+            uint32_t& id = this->codeIds[data.getCodes()[row]];
+            if (id == NULL_GROUP) id = this->newId(row);
+            return id;
+        } else {
+            return NULL_GROUP;
+        }
+    });
+}
+
+void KeyEncoder::encode(size_t begin, size_t end, std::vector<uint32_t>& ids) {
+    ids.resize(end - begin);
+    for (size_t row = begin; row < end; ++row) {
+        ids[row - begin] = this->encodeRow(row);
+    }
+}
+
+uint32_t KeyEncoder::lookup(int value) const {
+    auto it = this->intIds.find(value);
+    return it == this->intIds.end() ? NULL_GROUP : it->second;
+}
+
+uint32_t KeyEncoder::lookup(double value) const {
+    auto it = this->doubleIds.find(normalizedBits(value));
+    return it == this->doubleIds.end() ? NULL_GROUP : it->second;
+}
+
+uint32_t KeyEncoder::lookup(bool value) const {
+    return this->codeIds.size() == 2 ? this->codeIds[value ? 1 : 0] : NULL_GROUP;
+}
+
+uint32_t KeyEncoder::lookup(std::string_view value) const {
+    if (this->buffer->kind() == ColumnKind::Dictionary) {
+        std::optional<uint32_t> code = this->buffer->getDictionary().codeOf(std::string(value));
+        return code.has_value() ? this->codeIds[*code] : NULL_GROUP;
+    }
+    auto it = this->stringIds.find(value);
+    return it == this->stringIds.end() ? NULL_GROUP : it->second;
+}
+
+// GROUP KEY ENCODER
+
+GroupKeyEncoder::GroupKeyEncoder(const std::vector<const ColumnBuffer*>& buffers) {
+    if (buffers.empty()) {
+        throw std::invalid_argument("groupBy needs at least one key column");
+    }
+    for (const ColumnBuffer* buffer : buffers) {
+        this->columns.emplace_back(*buffer);
+    }
+    this->pairIds.resize(buffers.size() - 1);
+}
+
+const std::vector<size_t>& GroupKeyEncoder::getFirstRows() const {
+    return this->columns.size() == 1 ? this->columns.front().getFirstRows() : this->firstRows;
+}
+
+uint32_t GroupKeyEncoder::encodeRow(size_t row) {
+    uint32_t id = this->columns.front().encodeRow(row);
+    for (size_t stage = 0; stage < this->pairIds.size() && id != NULL_GROUP; ++stage) {
+        uint32_t columnId = this->columns[stage + 1].encodeRow(row);
+        if (columnId == NULL_GROUP) {
+            return NULL_GROUP;
+        }
+        auto& ids = this->pairIds[stage];
+        auto [it, inserted] = ids.try_emplace(pairKey(id, columnId), static_cast<uint32_t>(ids.size()));
+        if (inserted && stage + 1 == this->pairIds.size()) {
+            this->firstRows.push_back(row);
+        }
+        id = it->second;
+    }
+    return id;
+}
+
+uint32_t GroupKeyEncoder::lookup(const std::vector<uint32_t>& columnIds) const {
+    uint32_t id = columnIds.front();
+    for (size_t stage = 0; stage < this->pairIds.size() && id != NULL_GROUP; ++stage) {
+        if (columnIds[stage + 1] == NULL_GROUP) {
+            return NULL_GROUP;
+        }
+        auto it = this->pairIds[stage].find(pairKey(id, columnIds[stage + 1]));
+        id = it == this->pairIds[stage].end() ? NULL_GROUP : it->second;
+    }
+    return id;
+}
+
+void GroupKeyEncoder::encode(size_t begin, size_t end, std::vector<uint32_t>& ids) {
+    this->columns.front().encode(begin, end, ids);
+    for (size_t stage = 0; stage < this->pairIds.size(); ++stage) {
+        bool last = stage + 1 == this->pairIds.size();
+        auto& stageIds = this->pairIds[stage];
+        this->columns[stage + 1].encode(begin, end, this->columnIds);
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (ids[i] == NULL_GROUP || this->columnIds[i] == NULL_GROUP) {
+                ids[i] = NULL_GROUP;
+                continue;
+            }
+            auto [it, inserted] = stageIds.try_emplace(pairKey(ids[i], this->columnIds[i]), static_cast<uint32_t>(stageIds.size()));
+            if (inserted && last) {
+                this->firstRows.push_back(begin + i);
+            }
+            ids[i] = it->second;
+        }
+    }
+}
+
+// AGGREGATOR
+
+Aggregator::Aggregator(const ColumnBuffer& buffer, AggregationOp op) : op(op), buffer(&buffer) {
+    if (buffer.kind() == ColumnKind::Dictionary && (op == AggregationOp::Min || op == AggregationOp::Max)) {
+        // compare dictionary cells by the rank of their code instead of the string itself
+        const std::vector<std::string>& dictionary = buffer.getDictionary().getDictionary();
+        std::vector<uint32_t> order(dictionary.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&dictionary](uint32_t a, uint32_t b) {
+            return dictionary[a] < dictionary[b];
+        });
+        this->dictionaryRanks.resize(dictionary.size());
+        for (uint32_t rank = 0; rank < order.size(); rank++) {
+            this->dictionaryRanks[order[rank]] = rank;
+        }
+    }
+    if (buffer.kind() == ColumnKind::Dictionary && op == AggregationOp::ApproxCountDistinct) {
+        this->codeHashes = DistinctSketch::codeHashes(buffer.getDictionary());
+    }
+}
+
+bool Aggregator::isBetter(size_t candidate, size_t current) const {
+    if (current == NO_ROW) {
+        return true;
+    }
+    bool less;
+    if (!this->dictionaryRanks.empty()) {
+        const std::vector<uint32_t>& codes = this->buffer->getDictionary().getCodes();
+        less = this->op == AggregationOp::Min
+               ? this->dictionaryRanks[codes[candidate]] < this->dictionaryRanks[codes[current]]
+               : this->dictionaryRanks[codes[current]] < this->dictionaryRanks[codes[candidate]];
+    } else {
+        less = this->op == AggregationOp::Min
+               ? rowLess(*this->buffer, candidate, current)
+               : rowLess(*this->buffer, current, candidate);
+    }
+    return less;
+}
+
+void Aggregator::resize(size_t numberOfGroups) {
+    this->counts.resize(numberOfGroups, 0);
+    if (this->op == AggregationOp::Sum || this->op == AggregationOp::Mean) {
+        this->intSums.resize(numberOfGroups, 0);
+        this->doubleSums.resize(numberOfGroups, 0.0);
+    }
+    if (this->op == AggregationOp::Min || this->op == AggregationOp::Max) {
+        this->extremeRows.resize(numberOfGroups, NO_ROW);
+    }
+    if (this->op == AggregationOp::ApproxCountDistinct) {
+        this->distinctSketches.resize(numberOfGroups, DistinctSketch(DISTINCT_SKETCH_GROUP_PRECISION));
+    }
+}
+
+void Aggregator::update(const std::vector<uint32_t>& groupIds, size_t begin, size_t end) {
+    const ValidityBitmap& validity = this->buffer->getValidity();
+    for (size_t row = begin; row < end; ++row) {
+        uint32_t group = groupIds[row - begin];
+        if (group != NULL_GROUP && validity.get(row)) {
+            this->counts[group]++;
+        }
+    }
+    if (this->op == AggregationOp::Count) {
+        return;
+    }
+
+    this->buffer->visit([&](const auto& data) {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (std::is_same_v<Storage, std::monostate>) {
+            return;
+        } else {
+            using T = typename Storage::value_type;
+            for (size_t row = begin; row < end; ++row) {
+                uint32_t group = groupIds[row - begin];
+                if (group == NULL_GROUP || !validity.get(row)) {
+                    continue;
+                }
+                if (this->op == AggregationOp::ApproxCountDistinct) {
+                    if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+                        this->distinctSketches[group].addHash(this->codeHashes[data.getCodes()[row]]);
+                    } else if constexpr (std::is_same_v<T, std::string>) {
+                        this->distinctSketches[group].addHash(DistinctSketch::hashValue(std::string_view(data[row])));
+                    } else {
+                        this->distinctSketches[group].addHash(DistinctSketch::hashValue(static_cast<T>(data[row])));
+                    }
+                } else if (this->op == AggregationOp::Sum || this->op == AggregationOp::Mean) {
+                    if constexpr (std::is_same_v<T, double>) {
+                        this->doubleSums[group] += data[row];
+                    } else if constexpr (std::is_arithmetic_v<T>) {
+                        // integers are summed exactly, partial sums merge without rounding
+                        this->intSums[group] += static_cast<int64_t>(data[row]);
+                    }
+                } else {
+                    size_t& current = this->extremeRows[group];
+                    if (current == NO_ROW) {
+                        current = row;
+                        continue;
+                    }
+                    bool better;
+                    if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+                        uint32_t candidateRank = this->dictionaryRanks[data.getCodes()[row]];
+                        uint32_t currentRank = this->dictionaryRanks[data.getCodes()[current]];
+                        better = this->op == AggregationOp::Min ? candidateRank < currentRank : currentRank < candidateRank;
+                    } else {
+                        better = this->op == AggregationOp::Min ? data[row] < data[current] : data[current] < data[row];
+                    }
+                    if (better) {
+                        current = row;
+                    }
+                }
+            }
+        }
+    });
+}
+
+void Aggregator::merge(const Aggregator& other, const std::vector<uint32_t>& otherGroups, const std::vector<uint32_t>& targetGroups) {
+    for (size_t i = 0; i < otherGroups.size(); ++i) {
+        uint32_t local = otherGroups[i];
+        uint32_t group = targetGroups[i];
+        this->counts[group] += other.counts[local];
+        if (this->op == AggregationOp::Sum || this->op == AggregationOp::Mean) {
+            this->intSums[group] += other.intSums[local];
+            this->doubleSums[group] += other.doubleSums[local];
+        }
+        if (this->op == AggregationOp::ApproxCountDistinct) {
+            this->distinctSketches[group].merge(other.distinctSketches[local]);
+        }
+        if ((this->op == AggregationOp::Min || this->op == AggregationOp::Max) && other.extremeRows[local] != NO_ROW) {
+            if (this->isBetter(other.extremeRows[local], this->extremeRows[group])) {
+                this->extremeRows[group] = other.extremeRows[local];
+            }
+        }
+    }
+}
+
+ColumnBuffer Aggregator::finalize(const std::vector<uint32_t>& groupOrder) const {
+    ColumnKind inputKind = this->buffer->kind();
+    bool numeric = inputKind == ColumnKind::Int || inputKind == ColumnKind::Double || inputKind == ColumnKind::Bool;
+
+    if (this->op == AggregationOp::Count) {
+        ColumnBuffer result(ColumnKind::Int);
+        result.reserve(groupOrder.size());
+        for (uint32_t group : groupOrder) {
+            result.append(ColumnType(static_cast<int>(this->counts[group])));
+        }
+        return result;
+    }
+
+    if (this->op == AggregationOp::ApproxCountDistinct) {
+        ColumnBuffer result(ColumnKind::Int);
+        result.reserve(groupOrder.size());
+        for (uint32_t group : groupOrder) {
+            result.append(ColumnType(static_cast<int>(std::llround(this->distinctSketches[group].estimate()))));
+        }
+        return result;
+    }
+
+    if (this->op == AggregationOp::Sum || this->op == AggregationOp::Mean) {
+        ColumnBuffer result(ColumnKind::Double);
+        result.reserve(groupOrder.size());
+        for (uint32_t group : groupOrder) {
+            double sum = inputKind == ColumnKind::Double
+                         ? this->doubleSums[group]
+                         : static_cast<double>(this->intSums[group]);
+            if (!numeric && this->counts[group] > 0) {
+                // text has no sum
+                result.append(ColumnType(std::nan("")));
+            } else if (this->op == AggregationOp::Sum) {
+                result.append(ColumnType(sum));
+            } else if (this->counts[group] > 0) {
+                result.append(ColumnType(sum / static_cast<double>(this->counts[group])));
+            } else {
+                result.appendNull();
+            }
+        }
+        return result;
+    }
+
+    ColumnBuffer result(inputKind);
+    result.reserve(groupOrder.size());
+    for (uint32_t group : groupOrder) {
+        size_t row = this->extremeRows[group];
+        result.append(row == NO_ROW ? std::nullopt : this->buffer->get(row));
+    }
+    return result;
+}
+
+// HASH AGGREGATION
+
+HashAggregation::HashAggregation(const std::vector<const ColumnBuffer*>& keyBuffers, const std::vector<std::pair<const ColumnBuffer*, AggregationOp>>& specs)
+        : keyBuffers(keyBuffers), specs(specs), keys(keyBuffers) {
+    for (const auto& [buffer, op] : specs) {
+        this->aggregators.emplace_back(*buffer, op);
+    }
+}
+
+void HashAggregation::consume(size_t begin, size_t end) {
+    std::vector<uint32_t> groupIds;
+    groupIds.reserve(GROUPBY_MORSEL_SIZE);
+    for (size_t morsel = begin; morsel < end; morsel += GROUPBY_MORSEL_SIZE) {
+        size_t morselEnd = std::min(end, morsel + GROUPBY_MORSEL_SIZE);
+        this->keys.encode(morsel, morselEnd, groupIds);
+        const std::vector<size_t>& firstRows = this->keys.getFirstRows();
+        this->groupRows.insert(this->groupRows.end(), firstRows.begin() + static_cast<std::ptrdiff_t>(this->groupRows.size()), firstRows.end());
+        for (auto& aggregator : this->aggregators) {
+            aggregator.resize(this->keys.cardinality());
+            aggregator.update(groupIds, morsel, morselEnd);
+        }
+    }
+}
+
+void HashAggregation::consumeParallel(size_t begin, size_t end, size_t threads) {
+    size_t numberOfMorsels = (end - begin + GROUPBY_MORSEL_SIZE - 1) / GROUPBY_MORSEL_SIZE;
+    threads = std::min(threads, numberOfMorsels);
+    if (threads <= 1) {
+        this->consume(begin, end);
+        return;
+    }
+
+    std::vector<HashAggregation> locals;
+    locals.reserve(threads);
+    for (size_t worker = 0; worker < threads; ++worker) {
+        locals.emplace_back(this->keyBuffers, this->specs);
+    }
+    parallelFor(numberOfMorsels, threads, [&](size_t morsel, size_t worker) {
+        size_t morselBegin = begin + morsel * GROUPBY_MORSEL_SIZE;
+        locals[worker].consume(morselBegin, std::min(end, morselBegin + GROUPBY_MORSEL_SIZE));
+    });
+    this->mergeLocal(locals, threads);
+}
+
+// Merges the thread-local tables into this one. Workers took their morsels in
+// increasing order, so the first row of a local group is the earliest row of
+// that key the worker saw, and the minimum over workers is the global one.
+void HashAggregation::mergeLocal(std::vector<HashAggregation>& locals, size_t threads) {
+    size_t localGroups = 0;
+    for (const auto& local : locals) {
+        localGroups += local.numberOfGroups();
+    }
+    size_t numberOfPartitions = localGroups >= GROUPBY_PARTITION_MIN_GROUPS ? threads : 1;
+
+    // scatter the groups of every local table into partitions by key hash
+    std::vector<std::vector<std::vector<uint32_t>>> partitionGroups(locals.size());
+    parallelFor(locals.size(), threads, [&](size_t worker, size_t) {
+        auto& partitions = partitionGroups[worker];
+        partitions.resize(numberOfPartitions);
+        const std::vector<size_t>& rows = locals[worker].groupRows;
+        for (uint32_t group = 0; group < rows.size(); ++group) {
+            size_t partition = numberOfPartitions == 1 ? 0 : (keyHash(this->keyBuffers, rows[group]) >> 32) % numberOfPartitions;
+            partitions[partition].push_back(group);
+        }
+    });
+
+    // every partition assigns its own dense ids to the keys that hash into it
+    std::vector<std::vector<std::vector<uint32_t>>> targetGroups(numberOfPartitions, std::vector<std::vector<uint32_t>>(locals.size()));
+    std::vector<std::vector<size_t>> partitionRows(numberOfPartitions);
+    parallelFor(numberOfPartitions, threads, [&](size_t partition, size_t) {
+        GroupKeyEncoder encoder(this->keyBuffers);
+        std::vector<size_t>& rows = partitionRows[partition];
+        for (size_t worker = 0; worker < locals.size(); ++worker) {
+            const std::vector<size_t>& localRows = locals[worker].groupRows;
+            for (uint32_t group : partitionGroups[worker][partition]) {
+                uint32_t id = encoder.encodeRow(localRows[group]);
+                if (id == rows.size()) {
+                    rows.push_back(localRows[group]);
+                } else {
+                    rows[id] = std::min(rows[id], localRows[group]);
+                }
+                targetGroups[partition][worker].push_back(id);
+            }
+        }
+    });
+
+    std::vector<uint32_t> offsets(numberOfPartitions, 0);
+    this->groupRows.clear();
+    for (size_t partition = 0; partition < numberOfPartitions; ++partition) {
+        offsets[partition] = static_cast<uint32_t>(this->groupRows.size());
+        this->groupRows.insert(this->groupRows.end(), partitionRows[partition].begin(), partitionRows[partition].end());
+    }
+    for (auto& aggregator : this->aggregators) {
+        aggregator.resize(this->groupRows.size());
+    }
+
+    // partitions own disjoint slots of the merged state
+    parallelFor(numberOfPartitions, threads, [&](size_t partition, size_t) {
+        for (size_t worker = 0; worker < locals.size(); ++worker) {
+            std::vector<uint32_t>& targets = targetGroups[partition][worker];
+            for (uint32_t& target : targets) {
+                target += offsets[partition];
+            }
+            for (size_t i = 0; i < this->aggregators.size(); ++i) {
+                this->aggregators[i].merge(locals[worker].aggregators[i], partitionGroups[worker][partition], targets);
+            }
+        }
+    });
+}
+
+// Groups in order of first appearance, or ordered by key values left to right
+std::vector<uint32_t> HashAggregation::groupOrder(bool sorted) const {
+    std::vector<uint32_t> order(this->numberOfGroups());
+    std::iota(order.begin(), order.end(), 0);
+    const std::vector<size_t>& firstRows = this->groupRows;
+    if (!sorted) {
+        std::sort(order.begin(), order.end(), [&firstRows](uint32_t a, uint32_t b) {
+            return firstRows[a] < firstRows[b];
+        });
+    } else {
+        std::sort(order.begin(), order.end(), [this, &firstRows](uint32_t a, uint32_t b) {
+            for (const ColumnBuffer* keyBuffer : this->keyBuffers) {
+                if (rowLess(*keyBuffer, firstRows[a], firstRows[b])) return true;
+                if (rowLess(*keyBuffer, firstRows[b], firstRows[a])) return false;
+            }
+            return false;
+        });
+    }
+    return order;
+}
+
+ColumnBuffer HashAggregation::keyColumn(size_t keyIndex, const std::vector<uint32_t>& groupOrder) const {
+    const ColumnBuffer& keyBuffer = *this->keyBuffers[keyIndex];
+    ColumnBuffer result(keyBuffer.kind());
+    result.reserve(groupOrder.size());
+    for (uint32_t group : groupOrder) {
+        result.append(keyBuffer.get(this->groupRows[group]));
+    }
+    return result;
+}
+
+ColumnBuffer HashAggregation::result(size_t aggregatorIndex, const std::vector<uint32_t>& groupOrder) const {
+    return this->aggregators[aggregatorIndex].finalize(groupOrder);
+}
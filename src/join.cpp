@@ -0,0 +1,333 @@
+#include "../include/join.h"
+#include "../include/parallel.h"
+
+JoinType parseJoinType(const std::string& how) {
+    if (how == "inner") return JoinType::Inner;
+    if (how == "left") return JoinType::Left;
+    if (how == "semi") return JoinType::Semi;
+    if (how == "anti") return JoinType::Anti;
+    throw std::invalid_argument("Unsupported join type: " + how);
+}
+
+// JOIN HASH TABLE
+
+JoinHashTable::JoinHashTable(const std::vector<const ColumnBuffer*>& buildKeys) : keys(buildKeys) {
+    size_t numberOfRows = buildKeys.front()->size();
+    this->rowGroups.reserve(numberOfRows);
+    std::vector<uint32_t> ids;
+    for (size_t morsel = 0; morsel < numberOfRows; morsel += GROUPBY_MORSEL_SIZE) {
+        this->keys.encode(morsel, std::min(numberOfRows, morsel + GROUPBY_MORSEL_SIZE), ids);
+        this->rowGroups.insert(this->rowGroups.end(), ids.begin(), ids.end());
+    }
+
+    // counting sort of the build rows by key id
+    this->groupStarts.assign(this->numberOfGroups() + 1, 0);
+    for (uint32_t group : this->rowGroups) {
+        if (group != NULL_GROUP) this->groupStarts[group + 1]++;
+    }
+    for (size_t group = 0; group < this->numberOfGroups(); ++group) {
+        this->groupStarts[group + 1] += this->groupStarts[group];
+    }
+    this->rows.resize(this->groupStarts.back());
+    std::vector<size_t> next(this->groupStarts.begin(), this->groupStarts.end() - 1);
+    for (size_t row = 0; row < numberOfRows; ++row) {
+        uint32_t group = this->rowGroups[row];
+        if (group != NULL_GROUP) this->rows[next[group]++] = row;
+    }
+}
+
+// KEY PROBE
+
+KeyProbe::KeyProbe(const GroupKeyEncoder& keys, const std::vector<const ColumnBuffer*>& probeKeys)
+        : keys(&keys), probeKeys(probeKeys), dictionaryIds(probeKeys.size()) {
+    for (size_t i = 0; i < probeKeys.size(); ++i) {
+        ColumnKind buildKind = keys.column(i).kind();
+        ColumnKind probeKind = probeKeys[i]->kind();
+        bool comparable = buildKind == probeKind
+                          || (isStringKind(buildKind) && isStringKind(probeKind))
+                          || buildKind == ColumnKind::Untyped || probeKind == ColumnKind::Untyped;
+        if (!comparable) {
+            throw TypeMismatchException();
+        }
+        if (probeKind == ColumnKind::Dictionary) {
+            for (const std::string& value : probeKeys[i]->getDictionary().getDictionary()) {
+                this->dictionaryIds[i].push_back(keys.column(i).lookup(std::string_view(value)));
+            }
+        }
+    }
+}
+
+uint32_t KeyProbe::find(size_t row, std::vector<uint32_t>& columnIds) const {
+    columnIds.resize(this->probeKeys.size());
+    for (size_t i = 0; i < this->probeKeys.size(); ++i) {
+        const ColumnBuffer& buffer = *this->probeKeys[i];
+        if (!buffer.isValid(row)) {
+            return NULL_GROUP;
+        }
+        const KeyEncoder& encoder = this->keys->column(i);
+        columnIds[i] = buffer.visit([&](const auto& data) -> uint32_t {
+            using Storage = std::decay_t<decltype(data)>;
+            if constexpr (std::is_same_v<Storage, std::monostate>) {
+                return NULL_GROUP;
+            } else if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+                return this->dictionaryIds[i][data.getCodes()[row]];
+            } else if constexpr (std::is_same_v<Storage, std::vector<std::string>>) {
+                return encoder.lookup(std::string_view(data[row]));
+            } else if constexpr (std::is_same_v<Storage, std::vector<bool>>) {
+                return encoder.lookup(static_cast<bool>(data[row]));
+            } else {
+                return encoder.lookup(data[row]);
+            }
+        });
+        if (columnIds[i] == NULL_GROUP) {
+            return NULL_GROUP;
+        }
+    }
+    return this->probeKeys.size() == 1 ? columnIds.front() : this->keys->lookup(columnIds);
+}
+
+// HASH JOIN
+
+template<class T>
+static std::vector<T> concatenate(std::vector<std::vector<T>>& parts) {
+    size_t total = 0;
+    for (const auto& part : parts) {
+        total += part.size();
+    }
+    std::vector<T> result;
+    result.reserve(total);
+    for (auto& part : parts) {
+        result.insert(result.end(), part.begin(), part.end());
+        std::vector<T>().swap(part);
+    }
+    return result;
+}
+
+// The left side is the larger one: probe it in order, matches come out in left order
+static JoinIndices probeLeft(const JoinHashTable& table, const KeyProbe& probe, size_t leftSize, JoinType type, size_t threads) {
+    size_t numberOfMorsels = (leftSize + GROUPBY_MORSEL_SIZE - 1) / GROUPBY_MORSEL_SIZE;
+    std::vector<std::vector<size_t>> leftParts(numberOfMorsels);
+    std::vector<std::vector<size_t>> rightParts(numberOfMorsels);
+    parallelFor(numberOfMorsels, threads, [&](size_t morsel, size_t) {
+        std::vector<uint32_t> columnIds;
+        std::vector<size_t>& leftRows = leftParts[morsel];
+        std::vector<size_t>& rightRows = rightParts[morsel];
+        size_t morselEnd = std::min(leftSize, (morsel + 1) * GROUPBY_MORSEL_SIZE);
+        for (size_t row = morsel * GROUPBY_MORSEL_SIZE; row < morselEnd; ++row) {
+            uint32_t group = probe.find(row, columnIds);
+            if (type == JoinType::Semi || type == JoinType::Anti) {
+                if ((group != NULL_GROUP) == (type == JoinType::Semi)) leftRows.push_back(row);
+                continue;
+            }
+            if (group != NULL_GROUP) {
+                for (const size_t* match = table.rowsBegin(group); match != table.rowsEnd(group); ++match) {
+                    leftRows.push_back(row);
+                    rightRows.push_back(*match);
+                }
+            } else if (type == JoinType::Left) {
+                leftRows.push_back(row);
+                rightRows.push_back(NO_ROW);
+            }
+        }
+    });
+    return {concatenate(leftParts), concatenate(rightParts)};
+}
+
+// The left side is the smaller one and got the hash table: probe with the
+// right side, then bring the matches back into left order
+static JoinIndices probeRight(const JoinHashTable& table, const KeyProbe& probe, size_t leftSize, size_t rightSize, JoinType type, size_t threads) {
+    size_t numberOfMorsels = (rightSize + GROUPBY_MORSEL_SIZE - 1) / GROUPBY_MORSEL_SIZE;
+    std::vector<std::vector<size_t>> leftParts(numberOfMorsels);
+    std::vector<std::vector<size_t>> rightParts(numberOfMorsels);
+    std::vector<std::vector<uint32_t>> groupParts(numberOfMorsels);
+    parallelFor(numberOfMorsels, threads, [&](size_t morsel, size_t) {
+        std::vector<uint32_t> columnIds;
+        size_t morselEnd = std::min(rightSize, (morsel + 1) * GROUPBY_MORSEL_SIZE);
+        for (size_t row = morsel * GROUPBY_MORSEL_SIZE; row < morselEnd; ++row) {
+            uint32_t group = probe.find(row, columnIds);
+            if (group == NULL_GROUP) {
+                continue;
+            }
+            if (type == JoinType::Semi || type == JoinType::Anti) {
+                groupParts[morsel].push_back(group);
+                continue;
+            }
+            for (const size_t* match = table.rowsBegin(group); match != table.rowsEnd(group); ++match) {
+                leftParts[morsel].push_back(*match);
+                rightParts[morsel].push_back(row);
+            }
+        }
+    });
+
+    JoinIndices result;
+    if (type == JoinType::Semi || type == JoinType::Anti) {
+        std::vector<bool> matched(table.numberOfGroups(), false);
+        for (const auto& groups : groupParts) {
+            for (uint32_t group : groups) matched[group] = true;
+        }
+        for (size_t row = 0; row < leftSize; ++row) {
+            uint32_t group = table.groupOfRow(row);
+            if ((group != NULL_GROUP && matched[group]) == (type == JoinType::Semi)) {
+                result.leftRows.push_back(row);
+            }
+        }
+        return result;
+    }
+
+    // stable counting sort of the pairs by left row, unmatched left rows keep one slot
+    std::vector<size_t> leftRows = concatenate(leftParts);
+    std::vector<size_t> rightRows = concatenate(rightParts);
+    std::vector<size_t> starts(leftSize + 1, 0);
+    for (size_t row : leftRows) {
+        starts[row + 1]++;
+    }
+    for (size_t row = 0; row < leftSize; ++row) {
+        if (type == JoinType::Left && starts[row + 1] == 0) starts[row + 1] = 1;
+        starts[row + 1] += starts[row];
+    }
+    result.leftRows.resize(starts.back());
+    result.rightRows.assign(starts.back(), NO_ROW);
+    for (size_t row = 0; row < leftSize; ++row) {
+        for (size_t slot = starts[row]; slot < starts[row + 1]; ++slot) result.leftRows[slot] = row;
+    }
+    for (size_t i = 0; i < leftRows.size(); ++i) {
+        result.rightRows[starts[leftRows[i]]++] = rightRows[i];
+    }
+    return result;
+}
+
+JoinIndices hashJoin(const std::vector<const ColumnBuffer*>& leftKeys,
+                     const std::vector<const ColumnBuffer*>& rightKeys,
+                     JoinType type,
+                     size_t threads) {
+    if (leftKeys.empty() || leftKeys.size() != rightKeys.size()) {
+        throw std::invalid_argument("join needs the same non-zero number of left and right keys");
+    }
+    size_t leftSize = leftKeys.front()->size();
+    size_t rightSize = rightKeys.front()->size();
+    if (leftSize < rightSize) {
+        JoinHashTable table(leftKeys);
+        KeyProbe probe(table.getKeys(), rightKeys);
+        return probeRight(table, probe, leftSize, rightSize, type, threads);
+    }
+    JoinHashTable table(rightKeys);
+    KeyProbe probe(table.getKeys(), leftKeys);
+    return probeLeft(table, probe, leftSize, type, threads);
+}
+
+// SORT-MERGE JOIN
+
+static size_t rowAt(const std::vector<size_t>& order, size_t position) {
+    return order.empty() ? position : order[position];
+}
+
+JoinIndices mergeJoin(const std::vector<const ColumnBuffer*>& leftKeys,
+                      const std::vector<const ColumnBuffer*>& rightKeys,
+                      JoinType type,
+                      const std::vector<size_t>& leftOrder,
+                      const std::vector<size_t>& rightOrder) {
+    if (leftKeys.empty() || leftKeys.size() != rightKeys.size()) {
+        throw std::invalid_argument("join needs the same non-zero number of left and right keys");
+    }
+    size_t leftSize = leftKeys.front()->size();
+    size_t rightSize = rightKeys.front()->size();
+    JoinIndices result;
+    auto unmatched = [&result, type](size_t row) {
+        if (type == JoinType::Left) {
+            result.leftRows.push_back(row);
+            result.rightRows.push_back(NO_ROW);
+        } else if (type == JoinType::Anti) {
+            result.leftRows.push_back(row);
+        }
+    };
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < leftSize && j < rightSize) {
+        size_t leftRow = rowAt(leftOrder, i);
+        size_t rightRow = rowAt(rightOrder, j);
+        int order = compareRows(leftKeys, leftRow, rightKeys, rightRow);
+        if (order < 0 || (order == 0 && hasNullKey(leftKeys, leftRow))) {
+            unmatched(leftRow);
+            i++;
+            continue;
+        }
+        if (order > 0) {
+            j++;
+            continue;
+        }
+
+        // equal runs on both sides
+        size_t leftEnd = i + 1;
+        while (leftEnd < leftSize && compareRows(leftKeys, rowAt(leftOrder, leftEnd), leftKeys, leftRow) == 0) leftEnd++;
+        size_t rightEnd = j + 1;
+        while (rightEnd < rightSize && compareRows(rightKeys, rowAt(rightOrder, rightEnd), rightKeys, rightRow) == 0) rightEnd++;
+        for (; i < leftEnd; ++i) {
+            size_t row = rowAt(leftOrder, i);
+            if (type == JoinType::Semi) {
+                result.leftRows.push_back(row);
+            } else if (type == JoinType::Inner || type == JoinType::Left) {
+                for (size_t match = j; match < rightEnd; ++match) {
+                    result.leftRows.push_back(row);
+                    result.rightRows.push_back(rowAt(rightOrder, match));
+                }
+            }
+        }
+        j = rightEnd;
+    }
+    for (; i < leftSize; ++i) {
+        unmatched(rowAt(leftOrder, i));
+    }
+    return result;
+}
+
+// AS-OF JOIN
+
+static double onValue(const ColumnBuffer& buffer, size_t row) {
+    switch (buffer.kind()) {
+        case ColumnKind::Int: return buffer.values<int>()[row];
+        case ColumnKind::Double: return buffer.values<double>()[row];
+        default: throw InvalidTypeException();
+    }
+}
+
+std::vector<size_t> asofMatches(const ColumnBuffer& leftOn,
+                                const ColumnBuffer& rightOn,
+                                const std::vector<const ColumnBuffer*>& leftBy,
+                                const std::vector<const ColumnBuffer*>& rightBy,
+                                std::optional<double> tolerance,
+                                const std::vector<size_t>& leftOrder,
+                                const std::vector<size_t>& rightOrder) {
+    if (leftBy.size() != rightBy.size()) {
+        throw std::invalid_argument("asofJoin needs the same number of left and right by columns");
+    }
+    size_t leftSize = leftOn.size();
+    size_t rightSize = rightOn.size();
+    std::vector<size_t> matches(leftSize, NO_ROW);
+
+    size_t j = 0;
+    size_t last = NO_ROW;
+    for (size_t i = 0; i < leftSize; ++i) {
+        size_t leftRow = rowAt(leftOrder, i);
+        if (!leftOn.isValid(leftRow) || hasNullKey(leftBy, leftRow)) {
+            continue;
+        }
+        double value = onValue(leftOn, leftRow);
+        while (j < rightSize) {
+            size_t rightRow = rowAt(rightOrder, j);
+            int group = compareRows(rightBy, rightRow, leftBy, leftRow);
+            if (group > 0 || (group == 0 && (!rightOn.isValid(rightRow) || onValue(rightOn, rightRow) > value))) {
+                break;
+            }
+            last = group == 0 ? rightRow : NO_ROW;
+            j++;
+        }
+        if (last == NO_ROW || compareRows(rightBy, last, leftBy, leftRow) != 0) {
+            continue;
+        }
+        if (!tolerance.has_value() || value - onValue(rightOn, last) <= *tolerance) {
+            matches[leftRow] = last;
+        }
+    }
+    return matches;
+}
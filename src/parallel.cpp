@@ -0,0 +1,143 @@
+#include "../include/parallel.h"
+#include <atomic>
+#include <exception>
+#include <memory>
+
+size_t hardwareThreads() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// THREAD POOL
+
+ThreadPool::ThreadPool(size_t threads) {
+    for (size_t i = 1; i < threads; ++i) {
+        this->workers.emplace_back([this]() {
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    this->wakeUp.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+                    if (this->jobs.empty()) {
+                        return;
+                    }
+                    job = std::move(this->jobs.front());
+                    this->jobs.pop_front();
+                }
+                job();
+            }
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wakeUp.notify_all();
+    for (auto& worker : this->workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back(std::move(job));
+    }
+    this->wakeUp.notify_one();
+}
+
+// Shared between the caller and its helper jobs. A helper that only starts
+// after every task was handed out leaves without touching the body, so the
+// caller just waits for the helpers that actually joined.
+struct ParallelForState {
+    std::function<void(size_t, size_t)> body;
+    size_t numberOfTasks = 0;
+    std::atomic<size_t> nextTask{0};
+    std::atomic<size_t> nextWorker{1};
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t running = 0;
+    std::exception_ptr error;
+
+    void work(size_t worker) {
+        try {
+            for (size_t task = this->nextTask++; task < this->numberOfTasks; task = this->nextTask++) {
+                this->body(task, worker);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (!this->error) this->error = std::current_exception();
+            this->nextTask = this->numberOfTasks;
+        }
+    }
+};
+
+void ThreadPool::parallelFor(size_t numberOfTasks, size_t maxWorkers, const std::function<void(size_t task, size_t worker)>& body) {
+    size_t threads = std::max<size_t>(1, std::min({maxWorkers, numberOfTasks, this->size()}));
+    if (threads == 1) {
+        for (size_t task = 0; task < numberOfTasks; ++task) {
+            body(task, 0);
+        }
+        return;
+    }
+
+    auto state = std::make_shared<ParallelForState>();
+    state->body = body;
+    state->numberOfTasks = numberOfTasks;
+    for (size_t helper = 1; helper < threads; ++helper) {
+        this->submit([state]() {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->nextTask >= state->numberOfTasks) {
+                    return;
+                }
+                state->running++;
+            }
+            state->work(state->nextWorker++);
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->running--;
+            }
+            state->done.notify_all();
+        });
+    }
+    state->work(0);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state]() { return state->running == 0; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+// SHARED POOL
+
+static std::unique_ptr<ThreadPool>& sharedPoolSlot() {
+    static std::unique_ptr<ThreadPool> pool;
+    return pool;
+}
+
+ThreadPool& sharedThreadPool() {
+    auto& pool = sharedPoolSlot();
+    if (!pool) {
+        pool = std::make_unique<ThreadPool>(hardwareThreads());
+    }
+    return *pool;
+}
+
+// Must not be called while parallel work is running
+void setThreadPoolSize(size_t threads) {
+    sharedPoolSlot() = std::make_unique<ThreadPool>(std::max<size_t>(1, threads));
+}
+
+void parallelFor(size_t numberOfTasks, size_t threads, const std::function<void(size_t task, size_t worker)>& body) {
+    if (threads <= 1 || numberOfTasks <= 1) {
+        for (size_t task = 0; task < numberOfTasks; ++task) {
+            body(task, 0);
+        }
+        return;
+    }
+    sharedThreadPool().parallelFor(numberOfTasks, threads, body);
+}
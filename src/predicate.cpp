@@ -0,0 +1,308 @@
+#include "../include/predicate.h"
+#include "../include/dataframe.h"
+#include "../include/parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string_view>
+
+enum class ConditionKind {
+    CompareValue,
+    CompareColumns,
+    IsNull,
+    NotNull,
+    And,
+    Or,
+    Not
+};
+
+struct Condition::Node {
+    ConditionKind kind;
+    CompareOp op = CompareOp::Equal;
+    std::string column;
+    std::string otherColumn;
+    ColumnType value;
+    std::shared_ptr<const Node> left;
+    std::shared_ptr<const Node> right;
+};
+
+// KERNELS
+
+// Packs test(i) for the rows of words [beginWord, endWord) into out. Whole
+// words first store 64 results as bytes, a fixed length loop the compiler
+// turns into vector compares, then fold each 8 bytes into 8 bits with one
+// multiplication.
+template<class Test>
+static void packWords(size_t rows, size_t beginWord, size_t endWord, uint64_t* out, Test test) {
+    alignas(64) uint8_t results[64];
+    for (size_t w = beginWord; w < endWord; w++) {
+        size_t base = w << 6;
+        uint64_t bits = 0;
+        if (base + 64 <= rows) {
+            for (size_t j = 0; j < 64; j++) {
+                results[j] = test(base + j);
+            }
+            for (size_t byte = 0; byte < 8; byte++) {
+                uint64_t eight;
+                std::memcpy(&eight, results + 8 * byte, sizeof(eight));
+                bits |= ((eight * 0x0102040810204080ULL) >> 56) << (8 * byte);
+            }
+        } else {
+            for (size_t j = 0; base + j < rows; j++) {
+                bits |= static_cast<uint64_t>(test(base + j)) << j;
+            }
+        }
+        out[w - beginWord] = bits;
+    }
+}
+
+// Calls visitor with the std comparison functor matching op
+template<class Visitor>
+static void withComparison(CompareOp op, Visitor&& visitor) {
+    switch (op) {
+        case CompareOp::Equal: visitor(std::equal_to<>()); break;
+        case CompareOp::NotEqual: visitor(std::not_equal_to<>()); break;
+        case CompareOp::Less: visitor(std::less<>()); break;
+        case CompareOp::LessEqual: visitor(std::less_equal<>()); break;
+        case CompareOp::Greater: visitor(std::greater<>()); break;
+        case CompareOp::GreaterEqual: visitor(std::greater_equal<>()); break;
+    }
+}
+
+static bool holdsNumber(const ColumnType& value) {
+    return std::holds_alternative<int>(value) || std::holds_alternative<double>(value);
+}
+
+static void compareWithValue(const ColumnBuffer& buffer, CompareOp op, const ColumnType& value, size_t rows,
+                             size_t beginWord, size_t endWord, uint64_t* out) {
+    ColumnKind kind = buffer.kind();
+    if (kind == ColumnKind::Untyped) {
+        std::fill(out, out + (endWord - beginWord), 0);
+        return;
+    }
+    bool numericColumn = kind == ColumnKind::Int || kind == ColumnKind::Double;
+    if ((numericColumn && !holdsNumber(value))
+        || (kind == ColumnKind::Bool && !std::holds_alternative<bool>(value))
+        || (isStringKind(kind) && !std::holds_alternative<std::string>(value))) {
+        throw TypeMismatchException();
+    }
+    withComparison(op, [&](auto compare) {
+        if (kind == ColumnKind::Int && std::holds_alternative<int>(value)) {
+            const int* data = buffer.values<int>().data();
+            int literal = std::get<int>(value);
+            packWords(rows, beginWord, endWord, out, [data, literal, compare](size_t i) { return compare(data[i], literal); });
+        } else if (kind == ColumnKind::Int) {
+            const int* data = buffer.values<int>().data();
+            double literal = std::get<double>(value);
+            packWords(rows, beginWord, endWord, out, [data, literal, compare](size_t i) { return compare(static_cast<double>(data[i]), literal); });
+        } else if (kind == ColumnKind::Double) {
+            const double* data = buffer.values<double>().data();
+            double literal = convertValue<double>(value);
+            packWords(rows, beginWord, endWord, out, [data, literal, compare](size_t i) { return compare(data[i], literal); });
+        } else if (kind == ColumnKind::Bool) {
+            const std::vector<bool>& data = buffer.values<bool>();
+            bool literal = std::get<bool>(value);
+            packWords(rows, beginWord, endWord, out, [&data, literal, compare](size_t i) { return compare(data[i], literal); });
+        } else if (kind == ColumnKind::String) {
+            const std::vector<std::string>& data = buffer.values<std::string>();
+            std::string_view literal = std::get<std::string>(value);
+            packWords(rows, beginWord, endWord, out, [&data, literal, compare](size_t i) { return compare(std::string_view(data[i]), literal); });
+        } else if (op == CompareOp::Equal || op == CompareOp::NotEqual) {
+            // equality only compares codes, a literal missing from the dictionary matches no code
+            const DictionaryArray& dictionary = buffer.getDictionary();
+            uint32_t target = dictionary.codeOf(std::get<std::string>(value)).value_or(std::numeric_limits<uint32_t>::max());
+            const uint32_t* codes = dictionary.getCodes().data();
+            packWords(rows, beginWord, endWord, out, [codes, target, compare](size_t i) { return compare(codes[i], target); });
+        } else {
+            // every distinct string is compared once, rows only look up their code
+            const DictionaryArray& dictionary = buffer.getDictionary();
+            std::string_view literal = std::get<std::string>(value);
+            std::vector<uint8_t> matches(dictionary.cardinality());
+            for (size_t code = 0; code < matches.size(); code++) {
+                matches[code] = compare(std::string_view(dictionary.getDictionary()[code]), literal);
+            }
+            const uint32_t* codes = dictionary.getCodes().data();
+            const uint8_t* table = matches.data();
+            packWords(rows, beginWord, endWord, out, [codes, table](size_t i) { return table[codes[i]] != 0; });
+        }
+    });
+}
+
+template<class T>
+static const T* numericData(const ColumnBuffer& buffer) {
+    return buffer.values<T>().data();
+}
+
+static void compareColumns(const ColumnBuffer& a, const ColumnBuffer& b, CompareOp op, size_t rows,
+                           size_t beginWord, size_t endWord, uint64_t* out) {
+    ColumnKind kindA = a.kind();
+    ColumnKind kindB = b.kind();
+    if (kindA == ColumnKind::Untyped || kindB == ColumnKind::Untyped) {
+        std::fill(out, out + (endWord - beginWord), 0);
+        return;
+    }
+    bool numericA = kindA == ColumnKind::Int || kindA == ColumnKind::Double;
+    bool numericB = kindB == ColumnKind::Int || kindB == ColumnKind::Double;
+    if (isStringKind(kindA) != isStringKind(kindB) || (kindA == ColumnKind::Bool) != (kindB == ColumnKind::Bool)) {
+        throw TypeMismatchException();
+    }
+    withComparison(op, [&](auto compare) {
+        if (kindA == ColumnKind::Int && kindB == ColumnKind::Int) {
+            const int* x = numericData<int>(a);
+            const int* y = numericData<int>(b);
+            packWords(rows, beginWord, endWord, out, [x, y, compare](size_t i) { return compare(x[i], y[i]); });
+        } else if (numericA && numericB) {
+            // mixed kinds compare as doubles, the int side is widened for this range only
+            size_t base = beginWord << 6;
+            size_t length = std::min(rows, endWord << 6) - base;
+            std::vector<double> widened(length);
+            const double* x = nullptr;
+            const double* y = nullptr;
+            if (kindA == ColumnKind::Int) {
+                std::copy(numericData<int>(a) + base, numericData<int>(a) + base + length, widened.begin());
+                x = widened.data();
+                y = numericData<double>(b) + base;
+            } else {
+                x = numericData<double>(a) + base;
+                if (kindB == ColumnKind::Int) {
+                    std::copy(numericData<int>(b) + base, numericData<int>(b) + base + length, widened.begin());
+                    y = widened.data();
+                } else {
+                    y = numericData<double>(b) + base;
+                }
+            }
+            packWords(rows, beginWord, endWord, out, [x, y, base, compare](size_t i) { return compare(x[i - base], y[i - base]); });
+        } else {
+            packWords(rows, beginWord, endWord, out, [&a, &b, compare](size_t i) {
+                return a.isValid(i) && b.isValid(i) && compare(compareCells(a, i, b, i), 0);
+            });
+        }
+    });
+}
+
+// EVALUATION
+
+const ColumnBuffer& Condition::bufferOf(const DataFrame& frame, const std::string& name) {
+    return *frame.keyBuffers({name}).front();
+}
+
+void Condition::evaluateRange(const Node& node, const DataFrame& frame, size_t rows, size_t beginWord, size_t endWord, uint64_t* out) {
+    size_t numberOfWords = endWord - beginWord;
+    switch (node.kind) {
+        case ConditionKind::CompareValue: {
+            const ColumnBuffer& buffer = bufferOf(frame, node.column);
+            compareWithValue(buffer, node.op, node.value, rows, beginWord, endWord, out);
+            const uint64_t* validity = buffer.getValidity().getWords().data() + beginWord;
+            for (size_t w = 0; w < numberOfWords; w++) {
+                out[w] &= validity[w];
+            }
+            break;
+        }
+        case ConditionKind::CompareColumns: {
+            const ColumnBuffer& a = bufferOf(frame, node.column);
+            const ColumnBuffer& b = bufferOf(frame, node.otherColumn);
+            compareColumns(a, b, node.op, rows, beginWord, endWord, out);
+            const uint64_t* validityA = a.getValidity().getWords().data() + beginWord;
+            const uint64_t* validityB = b.getValidity().getWords().data() + beginWord;
+            for (size_t w = 0; w < numberOfWords; w++) {
+                out[w] &= validityA[w] & validityB[w];
+            }
+            break;
+        }
+        case ConditionKind::IsNull:
+        case ConditionKind::NotNull: {
+            const uint64_t* validity = bufferOf(frame, node.column).getValidity().getWords().data() + beginWord;
+            bool negate = node.kind == ConditionKind::IsNull;
+            for (size_t w = 0; w < numberOfWords; w++) {
+                out[w] = negate ? ~validity[w] : validity[w];
+            }
+            break;
+        }
+        case ConditionKind::And:
+        case ConditionKind::Or: {
+            evaluateRange(*node.left, frame, rows, beginWord, endWord, out);
+            std::vector<uint64_t> other(numberOfWords);
+            evaluateRange(*node.right, frame, rows, beginWord, endWord, other.data());
+            for (size_t w = 0; w < numberOfWords; w++) {
+                out[w] = node.kind == ConditionKind::And ? out[w] & other[w] : out[w] | other[w];
+            }
+            break;
+        }
+        case ConditionKind::Not: {
+            evaluateRange(*node.left, frame, rows, beginWord, endWord, out);
+            for (size_t w = 0; w < numberOfWords; w++) {
+                out[w] = ~out[w];
+            }
+            break;
+        }
+    }
+    // negations set the bits past the last row, keep them clear
+    if ((endWord << 6) > rows && numberOfWords > 0 && (rows & 63) != 0) {
+        out[numberOfWords - 1] &= (1ULL << (rows & 63)) - 1;
+    }
+}
+
+// Unknown columns are reported before any work starts, also on empty frames
+void Condition::checkColumns(const Node& node, const DataFrame& frame) {
+    if (!node.column.empty()) {
+        bufferOf(frame, node.column);
+    }
+    if (!node.otherColumn.empty()) {
+        bufferOf(frame, node.otherColumn);
+    }
+    if (node.left) {
+        checkColumns(*node.left, frame);
+    }
+    if (node.right) {
+        checkColumns(*node.right, frame);
+    }
+}
+
+Bitmask Condition::evaluate(const DataFrame& frame, size_t threads) const {
+    checkColumns(*this->node, frame);
+    size_t rows = frame.numberOfRows();
+    std::vector<uint64_t> words((rows + 63) >> 6);
+    size_t wordsPerRange = PREDICATE_RANGE_SIZE >> 6;
+    size_t tasks = (words.size() + wordsPerRange - 1) / wordsPerRange;
+    parallelFor(tasks, threads == 0 ? hardwareThreads() : threads, [&](size_t task, size_t) {
+        size_t beginWord = task * wordsPerRange;
+        size_t endWord = std::min(words.size(), beginWord + wordsPerRange);
+        evaluateRange(*this->node, frame, rows, beginWord, endWord, words.data() + beginWord);
+    });
+    return Bitmask(std::move(words), rows);
+}
+
+// BUILDERS
+
+Condition operator&&(const Condition& lhs, const Condition& rhs) {
+    return Condition(std::make_shared<const Condition::Node>(Condition::Node{ConditionKind::And, CompareOp::Equal, "", "", 0, lhs.node, rhs.node}));
+}
+
+Condition operator||(const Condition& lhs, const Condition& rhs) {
+    return Condition(std::make_shared<const Condition::Node>(Condition::Node{ConditionKind::Or, CompareOp::Equal, "", "", 0, lhs.node, rhs.node}));
+}
+
+Condition operator!(const Condition& condition) {
+    return Condition(std::make_shared<const Condition::Node>(Condition::Node{ConditionKind::Not, CompareOp::Equal, "", "", 0, condition.node, nullptr}));
+}
+
+Condition ColumnReference::compare(CompareOp op, const ColumnType& value) const {
+    return Condition(std::make_shared<const Condition::Node>(Condition::Node{ConditionKind::CompareValue, op, this->name, "", value, nullptr, nullptr}));
+}
+
+Condition ColumnReference::compare(CompareOp op, const ColumnReference& other) const {
+    return Condition(std::make_shared<const Condition::Node>(Condition::Node{ConditionKind::CompareColumns, op, this->name, other.name, 0, nullptr, nullptr}));
+}
+
+Condition ColumnReference::isNull() const {
+    return Condition(std::make_shared<const Condition::Node>(Condition::Node{ConditionKind::IsNull, CompareOp::Equal, this->name, "", 0, nullptr, nullptr}));
+}
+
+Condition ColumnReference::notNull() const {
+    return Condition(std::make_shared<const Condition::Node>(Condition::Node{ConditionKind::NotNull, CompareOp::Equal, this->name, "", 0, nullptr, nullptr}));
+}
+
+ColumnReference col(const std::string& name) {
+    return ColumnReference(name);
+}
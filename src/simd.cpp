@@ -0,0 +1,303 @@
+#include "../include/simd.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BABYPANDA_AVX2 1
+#include <immintrin.h>
+#endif
+
+static bool validAt(const uint64_t* validity, size_t row) {
+    return (validity[row >> 6] >> (row & 63)) & 1ULL;
+}
+
+// Whole 64 row words inside [begin, end), the rows before and after them are
+// left to the scalar kernels
+static void alignRange(size_t begin, size_t end, size_t& alignedBegin, size_t& alignedEnd) {
+    alignedBegin = std::min(end, (begin + 63) & ~size_t(63));
+    alignedEnd = std::max(alignedBegin, end & ~size_t(63));
+}
+
+// SCALAR KERNELS
+
+static size_t countValidScalar(const uint64_t* validity, size_t begin, size_t end) {
+    size_t alignedBegin, alignedEnd;
+    alignRange(begin, end, alignedBegin, alignedEnd);
+    size_t count = 0;
+    for (size_t i = begin; i < alignedBegin; i++) count += validAt(validity, i);
+    for (size_t w = alignedBegin >> 6; w < alignedEnd >> 6; w++) count += std::popcount(validity[w]);
+    for (size_t i = alignedEnd; i < end; i++) count += validAt(validity, i);
+    return count;
+}
+
+template<class T, class Sum>
+static Sum sumScalar(const T* data, const uint64_t* validity, size_t begin, size_t end) {
+    Sum sum = 0;
+    for (size_t i = begin; i < end; i++) {
+        if (validAt(validity, i)) sum += static_cast<Sum>(data[i]);
+    }
+    return sum;
+}
+
+template<class T>
+static double squaredDeviationsScalar(const T* data, const uint64_t* validity, size_t begin, size_t end, double mean) {
+    double sum = 0.0;
+    for (size_t i = begin; i < end; i++) {
+        if (validAt(validity, i)) {
+            double deviation = static_cast<double>(data[i]) - mean;
+            sum += deviation * deviation;
+        }
+    }
+    return sum;
+}
+
+template<class T>
+static MinMax<T> minMaxScalar(const T* data, const uint64_t* validity, size_t begin, size_t end) {
+    MinMax<T> result{std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max(),
+                     std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest(),
+                     false};
+    for (size_t i = begin; i < end; i++) {
+        if (validAt(validity, i)) {
+            result.min = data[i] < result.min ? data[i] : result.min;
+            result.max = data[i] > result.max ? data[i] : result.max;
+            result.found = true;
+        }
+    }
+    return result;
+}
+
+static const NumericKernels SCALAR_KERNELS = {
+    "scalar",
+    countValidScalar,
+    sumScalar<double, double>,
+    sumScalar<int, int64_t>,
+    squaredDeviationsScalar<double>,
+    squaredDeviationsScalar<int>,
+    minMaxScalar<double>,
+    minMaxScalar<int>,
+};
+
+const NumericKernels& scalarKernels() {
+    return SCALAR_KERNELS;
+}
+
+// AVX2 KERNELS
+
+#ifdef BABYPANDA_AVX2
+#define AVX2_TARGET __attribute__((target("avx2,popcnt")))
+
+// Lane masks of four 64 bit lanes for a nibble of validity bits
+AVX2_TARGET static __m256d laneMask4(uint64_t bits) {
+    const __m256i select = _mm256_setr_epi64x(1, 2, 4, 8);
+    __m256i broadcast = _mm256_set1_epi64x(static_cast<long long>(bits));
+    return _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(broadcast, select), select));
+}
+
+// Lane masks of eight 32 bit lanes for a byte of validity bits
+AVX2_TARGET static __m256i laneMask8(uint64_t bits) {
+    const __m256i select = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256i broadcast = _mm256_set1_epi32(static_cast<int>(bits));
+    return _mm256_cmpeq_epi32(_mm256_and_si256(broadcast, select), select);
+}
+
+AVX2_TARGET static double horizontalSum(__m256d v) {
+    __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+AVX2_TARGET static size_t countValidAvx2(const uint64_t* validity, size_t begin, size_t end) {
+    size_t alignedBegin, alignedEnd;
+    alignRange(begin, end, alignedBegin, alignedEnd);
+    size_t count = countValidScalar(validity, begin, alignedBegin) + countValidScalar(validity, alignedEnd, end);
+    for (size_t w = alignedBegin >> 6; w < alignedEnd >> 6; w++) {
+        count += static_cast<size_t>(_mm_popcnt_u64(validity[w]));
+    }
+    return count;
+}
+
+AVX2_TARGET static double sumDoubleAvx2(const double* data, const uint64_t* validity, size_t begin, size_t end) {
+    size_t alignedBegin, alignedEnd;
+    alignRange(begin, end, alignedBegin, alignedEnd);
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    for (size_t w = alignedBegin >> 6; w < alignedEnd >> 6; w++) {
+        uint64_t bits = validity[w];
+        const double* block = data + (w << 6);
+        for (size_t g = 0; g < 64; g += 8) {
+            acc0 = _mm256_add_pd(acc0, _mm256_and_pd(_mm256_loadu_pd(block + g), laneMask4(bits >> g)));
+            acc1 = _mm256_add_pd(acc1, _mm256_and_pd(_mm256_loadu_pd(block + g + 4), laneMask4(bits >> (g + 4))));
+        }
+    }
+    return horizontalSum(_mm256_add_pd(acc0, acc1))
+           + sumScalar<double, double>(data, validity, begin, alignedBegin) + sumScalar<double, double>(data, validity, alignedEnd, end);
+}
+
+AVX2_TARGET static int64_t sumIntAvx2(const int* data, const uint64_t* validity, size_t begin, size_t end) {
+    size_t alignedBegin, alignedEnd;
+    alignRange(begin, end, alignedBegin, alignedEnd);
+    __m256i acc = _mm256_setzero_si256();
+    for (size_t w = alignedBegin >> 6; w < alignedEnd >> 6; w++) {
+        uint64_t bits = validity[w];
+        const int* block = data + (w << 6);
+        for (size_t g = 0; g < 64; g += 8) {
+            __m256i v = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + g)), laneMask8(bits >> g));
+            acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+            acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+        }
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+           + sumScalar<int, int64_t>(data, validity, begin, alignedBegin) + sumScalar<int, int64_t>(data, validity, alignedEnd, end);
+}
+
+AVX2_TARGET static double squaredDeviationsDoubleAvx2(const double* data, const uint64_t* validity, size_t begin, size_t end, double mean) {
+    size_t alignedBegin, alignedEnd;
+    alignRange(begin, end, alignedBegin, alignedEnd);
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    __m256d center = _mm256_set1_pd(mean);
+    for (size_t w = alignedBegin >> 6; w < alignedEnd >> 6; w++) {
+        uint64_t bits = validity[w];
+        const double* block = data + (w << 6);
+        for (size_t g = 0; g < 64; g += 8) {
+            __m256d d0 = _mm256_and_pd(_mm256_sub_pd(_mm256_loadu_pd(block + g), center), laneMask4(bits >> g));
+            __m256d d1 = _mm256_and_pd(_mm256_sub_pd(_mm256_loadu_pd(block + g + 4), center), laneMask4(bits >> (g + 4)));
+            acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(d0, d0));
+            acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(d1, d1));
+        }
+    }
+    return horizontalSum(_mm256_add_pd(acc0, acc1))
+           + squaredDeviationsScalar(data, validity, begin, alignedBegin, mean) + squaredDeviationsScalar(data, validity, alignedEnd, end, mean);
+}
+
+AVX2_TARGET static double squaredDeviationsIntAvx2(const int* data, const uint64_t* validity, size_t begin, size_t end, double mean) {
+    size_t alignedBegin, alignedEnd;
+    alignRange(begin, end, alignedBegin, alignedEnd);
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    __m256d center = _mm256_set1_pd(mean);
+    for (size_t w = alignedBegin >> 6; w < alignedEnd >> 6; w++) {
+        uint64_t bits = validity[w];
+        const int* block = data + (w << 6);
+        for (size_t g = 0; g < 64; g += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + g));
+            __m256d d0 = _mm256_sub_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), center);
+            __m256d d1 = _mm256_sub_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), center);
+            d0 = _mm256_and_pd(d0, laneMask4(bits >> g));
+            d1 = _mm256_and_pd(d1, laneMask4(bits >> (g + 4)));
+            acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(d0, d0));
+            acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(d1, d1));
+        }
+    }
+    return horizontalSum(_mm256_add_pd(acc0, acc1))
+           + squaredDeviationsScalar(data, validity, begin, alignedBegin, mean) + squaredDeviationsScalar(data, validity, alignedEnd, end, mean);
+}
+
+template<class T>
+static void mergeMinMax(MinMax<T>& result, const MinMax<T>& part) {
+    if (part.found) {
+        result.min = result.found ? std::min(result.min, part.min) : part.min;
+        result.max = result.found ? std::max(result.max, part.max) : part.max;
+        result.found = true;
+    }
+}
+
+AVX2_TARGET static MinMax<double> minMaxDoubleAvx2(const double* data, const uint64_t* validity, size_t begin, size_t end) {
+    size_t alignedBegin, alignedEnd;
+    alignRange(begin, end, alignedBegin, alignedEnd);
+    const double infinity = std::numeric_limits<double>::infinity();
+    __m256d positive = _mm256_set1_pd(infinity);
+    __m256d negative = _mm256_set1_pd(-infinity);
+    __m256d low = positive;
+    __m256d high = negative;
+    uint64_t any = 0;
+    for (size_t w = alignedBegin >> 6; w < alignedEnd >> 6; w++) {
+        uint64_t bits = validity[w];
+        any |= bits;
+        const double* block = data + (w << 6);
+        for (size_t g = 0; g < 64; g += 4) {
+            __m256d v = _mm256_loadu_pd(block + g);
+            __m256d mask = laneMask4(bits >> g);
+            // min_pd and max_pd return their second operand when the first is NaN
+            low = _mm256_min_pd(_mm256_blendv_pd(positive, v, mask), low);
+            high = _mm256_max_pd(_mm256_blendv_pd(negative, v, mask), high);
+        }
+    }
+    alignas(32) double lows[4];
+    alignas(32) double highs[4];
+    _mm256_store_pd(lows, low);
+    _mm256_store_pd(highs, high);
+    MinMax<double> result{infinity, -infinity, any != 0};
+    for (size_t lane = 0; lane < 4; lane++) {
+        result.min = std::min(result.min, lows[lane]);
+        result.max = std::max(result.max, highs[lane]);
+    }
+    mergeMinMax(result, minMaxScalar(data, validity, begin, alignedBegin));
+    mergeMinMax(result, minMaxScalar(data, validity, alignedEnd, end));
+    return result;
+}
+
+AVX2_TARGET static MinMax<int> minMaxIntAvx2(const int* data, const uint64_t* validity, size_t begin, size_t end) {
+    size_t alignedBegin, alignedEnd;
+    alignRange(begin, end, alignedBegin, alignedEnd);
+    __m256i largest = _mm256_set1_epi32(std::numeric_limits<int>::max());
+    __m256i smallest = _mm256_set1_epi32(std::numeric_limits<int>::lowest());
+    __m256i low = largest;
+    __m256i high = smallest;
+    uint64_t any = 0;
+    for (size_t w = alignedBegin >> 6; w < alignedEnd >> 6; w++) {
+        uint64_t bits = validity[w];
+        any |= bits;
+        const int* block = data + (w << 6);
+        for (size_t g = 0; g < 64; g += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + g));
+            __m256i mask = laneMask8(bits >> g);
+            low = _mm256_min_epi32(low, _mm256_blendv_epi8(largest, v, mask));
+            high = _mm256_max_epi32(high, _mm256_blendv_epi8(smallest, v, mask));
+        }
+    }
+    alignas(32) int lows[8];
+    alignas(32) int highs[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lows), low);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(highs), high);
+    MinMax<int> result{std::numeric_limits<int>::max(), std::numeric_limits<int>::lowest(), any != 0};
+    for (size_t lane = 0; lane < 8; lane++) {
+        result.min = std::min(result.min, lows[lane]);
+        result.max = std::max(result.max, highs[lane]);
+    }
+    mergeMinMax(result, minMaxScalar(data, validity, begin, alignedBegin));
+    mergeMinMax(result, minMaxScalar(data, validity, alignedEnd, end));
+    return result;
+}
+
+static const NumericKernels AVX2_KERNELS = {
+    "avx2",
+    countValidAvx2,
+    sumDoubleAvx2,
+    sumIntAvx2,
+    squaredDeviationsDoubleAvx2,
+    squaredDeviationsIntAvx2,
+    minMaxDoubleAvx2,
+    minMaxIntAvx2,
+};
+#endif
+
+const NumericKernels* avx2Kernels() {
+#ifdef BABYPANDA_AVX2
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    }();
+    return supported ? &AVX2_KERNELS : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+const NumericKernels& numericKernels() {
+    static const NumericKernels& chosen = avx2Kernels() != nullptr ? *avx2Kernels() : scalarKernels();
+    return chosen;
+}
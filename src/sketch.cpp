@@ -0,0 +1,348 @@
+#include "../include/sketch.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+// QUANTILE SKETCH
+
+QuantileSketch::QuantileSketch(size_t k) : k(std::max<size_t>(k, 8)) {
+    this->addLevel();
+}
+
+// Inverse of the empirical KLL bound 2.296 / k^0.9723 at 99% confidence
+QuantileSketch QuantileSketch::withAccuracy(double accuracy) {
+    if (accuracy <= 0.0 || accuracy >= 1.0) {
+        throw std::invalid_argument("Accuracy must be between 0 and 1.");
+    }
+    return QuantileSketch(static_cast<size_t>(std::ceil(std::pow(2.296 / accuracy, 1.0 / 0.9723))));
+}
+
+double QuantileSketch::normalizedRankError() const {
+    return 2.296 / std::pow(static_cast<double>(this->k), 0.9723);
+}
+
+size_t QuantileSketch::capacity(size_t level) const {
+    size_t depth = this->levels.size() - 1 - level;
+    return std::max<size_t>(2, static_cast<size_t>(std::ceil(this->k * std::pow(2.0 / 3.0, static_cast<double>(depth)))));
+}
+
+// Capacities depend on the depth below the top level, adding one changes them all
+void QuantileSketch::addLevel() {
+    this->levels.emplace_back();
+    this->budget = 0;
+    for (size_t level = 0; level < this->levels.size(); ++level) {
+        this->budget += this->capacity(level);
+    }
+}
+
+// xorshift64, the sketch only needs unbiased coin flips
+bool QuantileSketch::nextBit() {
+    this->randomState ^= this->randomState << 13;
+    this->randomState ^= this->randomState >> 7;
+    this->randomState ^= this->randomState << 17;
+    return this->randomState & 1;
+}
+
+// Compacts the lowest full level until the sketch is back within its budget
+void QuantileSketch::compress() {
+    while (this->retainedItems >= this->budget) {
+        size_t level = 0;
+        while (this->levels[level].size() < this->capacity(level)) {
+            level++;
+        }
+        if (level + 1 == this->levels.size()) {
+            this->addLevel();
+        }
+        std::vector<double>& items = this->levels[level];
+        std::sort(items.begin(), items.end());
+        // an odd value out stays behind at its level
+        size_t leftover = items.size() % 2;
+        std::vector<double>& above = this->levels[level + 1];
+        size_t before = above.size();
+        for (size_t i = leftover + (this->nextBit() ? 1 : 0); i < items.size(); i += 2) {
+            above.push_back(items[i]);
+        }
+        this->retainedItems -= items.size() - leftover - (above.size() - before);
+        items.resize(leftover);
+    }
+}
+
+void QuantileSketch::update(double value) {
+    if (std::isnan(value)) {
+        return;
+    }
+    if (this->count == 0) {
+        this->minValue = value;
+        this->maxValue = value;
+    } else {
+        this->minValue = std::min(this->minValue, value);
+        this->maxValue = std::max(this->maxValue, value);
+    }
+    this->count++;
+    this->levels.front().push_back(value);
+    if (++this->retainedItems >= this->budget) {
+        this->compress();
+    }
+}
+
+void QuantileSketch::update(const ColumnBuffer& buffer, size_t begin, size_t end) {
+    const ValidityBitmap& validity = buffer.getValidity();
+    buffer.visit([&](const auto& data) {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (!std::is_same_v<Storage, std::monostate> && !std::is_same_v<Storage, DictionaryArray>) {
+            if constexpr (std::is_arithmetic_v<typename Storage::value_type>) {
+                for (size_t i = begin; i < end; i++) {
+                    if (validity.get(i)) {
+                        this->update(static_cast<double>(data[i]));
+                    }
+                }
+            }
+        }
+    });
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+    if (other.k != this->k) {
+        throw std::invalid_argument("Only sketches of the same size can be merged.");
+    }
+    if (other.count == 0) {
+        return;
+    }
+    if (this->count == 0) {
+        this->minValue = other.minValue;
+        this->maxValue = other.maxValue;
+    } else {
+        this->minValue = std::min(this->minValue, other.minValue);
+        this->maxValue = std::max(this->maxValue, other.maxValue);
+    }
+    while (this->levels.size() < other.levels.size()) {
+        this->addLevel();
+    }
+    for (size_t level = 0; level < other.levels.size(); ++level) {
+        this->levels[level].insert(this->levels[level].end(), other.levels[level].begin(), other.levels[level].end());
+    }
+    this->retainedItems += other.retainedItems;
+    this->count += other.count;
+    this->compress();
+}
+
+double QuantileSketch::quantile(double p) const {
+    if (!(p >= 0.0 && p <= 1.0)) {
+        throw std::invalid_argument("Percentile must be between 0 and 1.");
+    }
+    if (this->count == 0) {
+        throw NoValidValuesException();
+    }
+    if (p == 0.0) return this->minValue;
+    if (p == 1.0) return this->maxValue;
+
+    std::vector<std::pair<double, uint64_t>> weighted;
+    weighted.reserve(this->retainedItems);
+    for (size_t level = 0; level < this->levels.size(); ++level) {
+        for (double value : this->levels[level]) {
+            weighted.emplace_back(value, uint64_t(1) << level);
+        }
+    }
+    std::sort(weighted.begin(), weighted.end());
+    uint64_t total = 0;
+    for (const auto& item : weighted) {
+        total += item.second;
+    }
+    double target = p * static_cast<double>(total);
+    uint64_t cumulative = 0;
+    for (const auto& [value, weight] : weighted) {
+        cumulative += weight;
+        if (static_cast<double>(cumulative) >= target) {
+            return value;
+        }
+    }
+    return this->maxValue;
+}
+
+// DISTINCT SKETCH
+
+DistinctSketch::DistinctSketch(unsigned precision) : precision(precision) {
+    if (precision < 4 || precision > 18) {
+        throw std::invalid_argument("Precision must be between 4 and 18.");
+    }
+}
+
+// splitmix64 finalizer, spreads nearby integers over all 64 bits
+static uint64_t mixBits(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ULL;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBULL;
+    value ^= value >> 31;
+    return value;
+}
+
+uint64_t DistinctSketch::hashValue(int value) {
+    return mixBits(static_cast<uint64_t>(static_cast<int64_t>(value)));
+}
+
+// All zeros and all NaNs count as one value each
+uint64_t DistinctSketch::hashValue(double value) {
+    if (value == 0.0) {
+        return mixBits(0);
+    }
+    if (std::isnan(value)) {
+        return mixBits(std::bit_cast<uint64_t>(std::numeric_limits<double>::quiet_NaN()));
+    }
+    return mixBits(std::bit_cast<uint64_t>(value));
+}
+
+uint64_t DistinctSketch::hashValue(bool value) {
+    return mixBits(value ? 1 : 0);
+}
+
+uint64_t DistinctSketch::hashValue(std::string_view value) {
+    return mixBits(std::hash<std::string_view>()(value));
+}
+
+std::vector<uint64_t> DistinctSketch::codeHashes(const DictionaryArray& dictionary) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(dictionary.cardinality());
+    for (const std::string& value : dictionary.getDictionary()) {
+        hashes.push_back(hashValue(std::string_view(value)));
+    }
+    return hashes;
+}
+
+double DistinctSketch::relativeError() const {
+    return 1.04 / std::sqrt(static_cast<double>(this->numberOfRegisters()));
+}
+
+// Sorts the new entries in and keeps the highest rank of every register
+void DistinctSketch::compactSparse() {
+    std::sort(this->sparse.begin() + static_cast<std::ptrdiff_t>(this->sparseSorted), this->sparse.end());
+    std::inplace_merge(this->sparse.begin(), this->sparse.begin() + static_cast<std::ptrdiff_t>(this->sparseSorted), this->sparse.end());
+    size_t kept = 0;
+    for (size_t i = 0; i < this->sparse.size(); ++i) {
+        if (kept > 0 && (this->sparse[kept - 1] >> 8) == (this->sparse[i] >> 8)) {
+            this->sparse[kept - 1] = this->sparse[i];
+        } else {
+            this->sparse[kept++] = this->sparse[i];
+        }
+    }
+    this->sparse.resize(kept);
+    this->sparseSorted = kept;
+    // four bytes per entry against one per register
+    if (kept * 4 >= this->numberOfRegisters()) {
+        this->toDense();
+    }
+}
+
+void DistinctSketch::toDense() {
+    this->registers.assign(this->numberOfRegisters(), 0);
+    for (uint32_t entry : this->sparse) {
+        uint8_t& slot = this->registers[entry >> 8];
+        slot = std::max(slot, static_cast<uint8_t>(entry & 0xFF));
+    }
+    this->sparse.clear();
+    this->sparse.shrink_to_fit();
+    this->sparseSorted = 0;
+}
+
+void DistinctSketch::addHash(uint64_t hash) {
+    uint32_t index = static_cast<uint32_t>(hash >> (64 - this->precision));
+    uint64_t rest = (hash << this->precision) | (uint64_t(1) << (this->precision - 1));
+    auto rank = static_cast<uint8_t>(std::countl_zero(rest) + 1);
+    if (!this->registers.empty()) {
+        this->registers[index] = std::max(this->registers[index], rank);
+        return;
+    }
+    this->sparse.push_back((index << 8) | rank);
+    // compacting once the unsorted tail doubles the list keeps inserts amortized O(log n)
+    if (this->sparse.size() >= std::max<size_t>(16, 2 * this->sparseSorted)) {
+        this->compactSparse();
+    }
+}
+
+void DistinctSketch::update(const ColumnBuffer& buffer, size_t begin, size_t end) {
+    // bulk updates would soon fill the registers anyway, skip the sparse phase
+    if (this->registers.empty() && end - begin >= this->numberOfRegisters()) {
+        this->toDense();
+    }
+    const ValidityBitmap& validity = buffer.getValidity();
+    buffer.visit([&](const auto& data) {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (std::is_same_v<Storage, DictionaryArray>) {
+            std::vector<uint64_t> hashes = codeHashes(data);
+            const std::vector<uint32_t>& codes = data.getCodes();
+            for (size_t i = begin; i < end; i++) {
+                if (validity.get(i)) {
+                    this->addHash(hashes[codes[i]]);
+                }
+            }
+        } else if constexpr (std::is_same_v<Storage, std::vector<std::string>>) {
+            for (size_t i = begin; i < end; i++) {
+                if (validity.get(i)) {
+                    this->addHash(hashValue(std::string_view(data[i])));
+                }
+            }
+        } else if constexpr (!std::is_same_v<Storage, std::monostate>) {
+            using T = typename Storage::value_type;
+            for (size_t i = begin; i < end; i++) {
+                if (validity.get(i)) {
+                    this->addHash(hashValue(static_cast<T>(data[i])));
+                }
+            }
+        }
+    });
+}
+
+void DistinctSketch::merge(const DistinctSketch& other) {
+    if (other.precision != this->precision) {
+        throw std::invalid_argument("Only sketches of the same precision can be merged.");
+    }
+    if (this->registers.empty() && other.registers.empty()) {
+        this->sparse.insert(this->sparse.end(), other.sparse.begin(), other.sparse.end());
+        this->compactSparse();
+        return;
+    }
+    if (this->registers.empty()) {
+        this->toDense();
+    }
+    if (other.registers.empty()) {
+        for (uint32_t entry : other.sparse) {
+            uint8_t& slot = this->registers[entry >> 8];
+            slot = std::max(slot, static_cast<uint8_t>(entry & 0xFF));
+        }
+        return;
+    }
+    for (size_t i = 0; i < this->registers.size(); ++i) {
+        this->registers[i] = std::max(this->registers[i], other.registers[i]);
+    }
+}
+
+// Raw HyperLogLog estimate, linear counting while many registers are still empty
+double DistinctSketch::estimate() const {
+    double m = static_cast<double>(this->numberOfRegisters());
+    double harmonic = 0.0;
+    size_t zeros = 0;
+    if (this->registers.empty()) {
+        DistinctSketch copy = *this;
+        copy.compactSparse();
+        if (!copy.registers.empty()) {
+            return copy.estimate();
+        }
+        zeros = this->numberOfRegisters() - copy.sparse.size();
+        harmonic = static_cast<double>(zeros);
+        for (uint32_t entry : copy.sparse) {
+            harmonic += std::ldexp(1.0, -static_cast<int>(entry & 0xFF));
+        }
+    } else {
+        for (uint8_t rank : this->registers) {
+            harmonic += std::ldexp(1.0, -static_cast<int>(rank));
+            zeros += rank == 0;
+        }
+    }
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double raw = alpha * m * m / harmonic;
+    if (raw <= 2.5 * m && zeros > 0) {
+        return m * std::log(m / static_cast<double>(zeros));
+    }
+    return raw;
+}
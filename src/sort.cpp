@@ -0,0 +1,562 @@
+#include "../include/sort.h"
+#include "../include/parallel.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+
+static std::string_view stringAt(const ColumnBuffer& buffer, size_t row) {
+    if (buffer.kind() == ColumnKind::Dictionary) {
+        return buffer.getDictionary()[row];
+    }
+    return buffer.values<std::string>()[row];
+}
+
+static double numberAt(const ColumnBuffer& buffer, size_t row) {
+    switch (buffer.kind()) {
+        case ColumnKind::Int: return buffer.values<int>()[row];
+        case ColumnKind::Double: return buffer.values<double>()[row];
+        default: return buffer.values<bool>()[row] ? 1.0 : 0.0;
+    }
+}
+
+template<class T>
+static int threeWay(const T& a, const T& b) {
+    return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+int compareCells(const ColumnBuffer& a, size_t i, const ColumnBuffer& b, size_t j) {
+    bool validA = a.isValid(i);
+    bool validB = b.isValid(j);
+    if (!validA || !validB) {
+        return validA == validB ? 0 : (validA ? -1 : 1);
+    }
+    ColumnKind kindA = a.kind();
+    ColumnKind kindB = b.kind();
+    if (isStringKind(kindA) != isStringKind(kindB)) {
+        throw TypeMismatchException();
+    }
+    if (isStringKind(kindA)) {
+        if (kindA == ColumnKind::Dictionary && &a == &b) {
+            const std::vector<uint32_t>& codes = a.getDictionary().getCodes();
+            if (codes[i] == codes[j]) return 0;
+        }
+        return threeWay(stringAt(a, i), stringAt(b, j));
+    }
+    if (kindA == kindB && kindA == ColumnKind::Int) {
+        return threeWay(a.values<int>()[i], b.values<int>()[j]);
+    }
+    return threeWay(numberAt(a, i), numberAt(b, j));
+}
+
+int compareRows(const std::vector<const ColumnBuffer*>& a, size_t i, const std::vector<const ColumnBuffer*>& b, size_t j) {
+    for (size_t key = 0; key < a.size(); ++key) {
+        int order = compareCells(*a[key], i, *b[key], j);
+        if (order != 0) {
+            return order;
+        }
+    }
+    return 0;
+}
+
+bool hasNullKey(const std::vector<const ColumnBuffer*>& keys, size_t row) {
+    for (const ColumnBuffer* key : keys) {
+        if (!key->isValid(row)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int compareKeys(const std::vector<const ColumnBuffer*>& keys, const std::vector<bool>& ascending, bool nullsFirst, size_t i, size_t j) {
+    for (size_t key = 0; key < keys.size(); ++key) {
+        bool validA = keys[key]->isValid(i);
+        bool validB = keys[key]->isValid(j);
+        if (validA != validB) {
+            return validA == nullsFirst ? 1 : -1;
+        }
+        int order = compareCells(*keys[key], i, *keys[key], j);
+        if (order != 0) {
+            return ascending[key] ? order : -order;
+        }
+    }
+    return 0;
+}
+
+// NORMALIZED KEYS
+
+static uint64_t normalizeInt(int value) {
+    return static_cast<uint32_t>(value) ^ 0x80000000u;
+}
+
+static uint64_t normalizeDouble(double value) {
+    if (std::isnan(value)) {
+        return ~0ULL;
+    }
+    if (value == 0.0) {
+        value = 0.0;
+    }
+    uint64_t bits = std::bit_cast<uint64_t>(value);
+    return (bits >> 63) ? ~bits : bits | (1ULL << 63);
+}
+
+// Dense rank of every row of a string column, equal strings share a rank
+static std::vector<uint64_t> stringRanks(const ColumnBuffer& buffer, uint64_t& maxRank) {
+    std::vector<uint64_t> ranks(buffer.size(), 0);
+    maxRank = 0;
+    if (buffer.kind() == ColumnKind::Dictionary) {
+        const DictionaryArray& dictionary = buffer.getDictionary();
+        const std::vector<std::string>& values = dictionary.getDictionary();
+        std::vector<uint32_t> order(values.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&values](uint32_t a, uint32_t b) { return values[a] < values[b]; });
+        std::vector<uint64_t> codeRanks(values.size(), 0);
+        for (size_t rank = 0; rank < order.size(); ++rank) {
+            codeRanks[order[rank]] = rank;
+        }
+        maxRank = values.empty() ? 0 : values.size() - 1;
+        const std::vector<uint32_t>& codes = dictionary.getCodes();
+        for (size_t row = 0; row < codes.size(); ++row) {
+            ranks[row] = codeRanks[codes[row]];
+        }
+        return ranks;
+    }
+
+    const std::vector<std::string>& values = buffer.values<std::string>();
+    std::vector<size_t> order;
+    order.reserve(values.size());
+    for (size_t row = 0; row < values.size(); ++row) {
+        if (buffer.isValid(row)) order.push_back(row);
+    }
+    std::sort(order.begin(), order.end(), [&values](size_t a, size_t b) {
+        return std::string_view(values[a]) < std::string_view(values[b]);
+    });
+    uint64_t rank = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i > 0 && values[order[i - 1]] != values[order[i]]) rank++;
+        ranks[order[i]] = rank;
+    }
+    maxRank = rank;
+    return ranks;
+}
+
+// Calls fn(begin, end) on consecutive row ranges, spread over the threads
+static void forEachRange(size_t numberOfRows, size_t threads, const std::function<void(size_t, size_t)>& fn) {
+    size_t numberOfRanges = (numberOfRows + SORT_RANGE_SIZE - 1) / SORT_RANGE_SIZE;
+    parallelFor(numberOfRanges, threads, [&](size_t range, size_t) {
+        fn(range * SORT_RANGE_SIZE, std::min(numberOfRows, (range + 1) * SORT_RANGE_SIZE));
+    });
+}
+
+// Normalized key of every row of a column, null rows get 0
+static std::vector<uint64_t> normalizedKeys(const ColumnBuffer& buffer, size_t threads) {
+    uint64_t maxRank = 0;
+    if (isStringKind(buffer.kind())) {
+        return stringRanks(buffer, maxRank);
+    }
+    std::vector<uint64_t> keys(buffer.size(), 0);
+    buffer.visit([&keys, threads](const auto& data) {
+        using Storage = std::decay_t<decltype(data)>;
+        if constexpr (std::is_same_v<Storage, std::vector<int>> || std::is_same_v<Storage, std::vector<double>>) {
+            forEachRange(data.size(), threads, [&keys, &data](size_t begin, size_t end) {
+                for (size_t row = begin; row < end; ++row) {
+                    if constexpr (std::is_same_v<Storage, std::vector<int>>) {
+                        keys[row] = normalizeInt(data[row]);
+                    } else {
+                        keys[row] = normalizeDouble(data[row]);
+                    }
+                }
+            });
+        } else if constexpr (std::is_same_v<Storage, std::vector<bool>>) {
+            for (size_t row = 0; row < data.size(); ++row) keys[row] = data[row] ? 1 : 0;
+        }
+    });
+    return keys;
+}
+
+// Radix keys of one column: normalized keys shifted down to start at zero,
+// mirrored for descending order, with nulls at 0 or one past the largest key.
+// When the range already needs all 64 bits nulls cannot be encoded and are
+// left for a separate partition pass.
+struct RadixKeys {
+    std::vector<uint64_t> keys;
+    unsigned bits = 0;
+    bool separateNulls = false;
+};
+
+static RadixKeys radixKeys(const ColumnBuffer& buffer, bool ascending, bool nullsFirst, size_t threads) {
+    RadixKeys result;
+    result.keys = normalizedKeys(buffer, threads);
+    const ValidityBitmap& validity = buffer.getValidity();
+    size_t validRows = validity.countValid();
+    if (validRows == 0) {
+        std::fill(result.keys.begin(), result.keys.end(), 0);
+        return result;
+    }
+    uint64_t minKey = ~0ULL;
+    uint64_t maxKey = 0;
+    std::mutex boundsMutex;
+    forEachRange(result.keys.size(), threads, [&](size_t begin, size_t end) {
+        uint64_t rangeMin = ~0ULL;
+        uint64_t rangeMax = 0;
+        for (size_t row = begin; row < end; ++row) {
+            if (validity.get(row)) {
+                rangeMin = std::min(rangeMin, result.keys[row]);
+                rangeMax = std::max(rangeMax, result.keys[row]);
+            }
+        }
+        std::lock_guard<std::mutex> lock(boundsMutex);
+        minKey = std::min(minKey, rangeMin);
+        maxKey = std::max(maxKey, rangeMax);
+    });
+    uint64_t range = maxKey - minKey;
+    bool hasNulls = validRows != result.keys.size();
+    result.separateNulls = hasNulls && range == ~0ULL;
+    uint64_t validOffset = hasNulls && nullsFirst && !result.separateNulls ? 1 : 0;
+    uint64_t nullKey = nullsFirst || result.separateNulls ? 0 : range + 1;
+    forEachRange(result.keys.size(), threads, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            if (validity.get(row)) {
+                result.keys[row] = (ascending ? result.keys[row] - minKey : maxKey - result.keys[row]) + validOffset;
+            } else {
+                result.keys[row] = nullKey;
+            }
+        }
+    });
+    result.bits = std::bit_width(hasNulls && !result.separateNulls ? range + 1 : range);
+    return result;
+}
+
+// RADIX SORT
+
+constexpr unsigned RADIX_BITS = 11;
+constexpr size_t RADIX_BUCKETS = size_t(1) << RADIX_BITS;
+// Below this many rows every pass stays in cache and plain LSD is fastest
+constexpr size_t RADIX_MSD_MIN_ROWS = 1 << 16;
+// Buckets this small are cheaper to finish with a comparison sort
+constexpr size_t RADIX_SMALL_BUCKET = 2048;
+
+// Stable LSD radix sort of n keys and their rows over the lowest `passes`
+// digits. The histograms of all passes come from one read of the keys, passes
+// where every row falls into the same bucket are skipped.
+template<class Row>
+static void lsdRadixSort(uint64_t* keys, Row* rows, size_t n, unsigned passes, uint64_t* keyScratch, Row* rowScratch) {
+    if (n < 2 || passes == 0) {
+        return;
+    }
+    if (n <= RADIX_SMALL_BUCKET) {
+        std::vector<std::pair<uint64_t, Row>> pairs(n);
+        for (size_t i = 0; i < n; ++i) {
+            pairs[i] = {keys[i], rows[i]};
+        }
+        std::stable_sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (size_t i = 0; i < n; ++i) {
+            keys[i] = pairs[i].first;
+            rows[i] = pairs[i].second;
+        }
+        return;
+    }
+    std::vector<size_t> histograms(passes * RADIX_BUCKETS, 0);
+    for (size_t i = 0; i < n; ++i) {
+        for (unsigned pass = 0; pass < passes; ++pass) {
+            histograms[pass * RADIX_BUCKETS + ((keys[i] >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1))]++;
+        }
+    }
+
+    bool inScratch = false;
+    for (unsigned pass = 0; pass < passes; ++pass) {
+        size_t* offsets = histograms.data() + pass * RADIX_BUCKETS;
+        unsigned shift = pass * RADIX_BITS;
+        if (offsets[(keys[0] >> shift) & (RADIX_BUCKETS - 1)] == n) {
+            continue;
+        }
+        size_t offset = 0;
+        for (size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket) {
+            size_t count = offsets[bucket];
+            offsets[bucket] = offset;
+            offset += count;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            size_t slot = offsets[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+            keyScratch[slot] = keys[i];
+            rowScratch[slot] = rows[i];
+        }
+        std::swap(keys, keyScratch);
+        std::swap(rows, rowScratch);
+        inScratch = !inScratch;
+    }
+    if (inScratch) {
+        std::copy(keys, keys + n, keyScratch);
+        std::copy(rows, rows + n, rowScratch);
+    }
+}
+
+// Stable radix sort of the rows by their keys, RADIX_BITS per digit. Large
+// inputs with several digits take one MSD pass on the top digit first, the
+// buckets are then small enough to finish with LSD passes inside the cache.
+// The scratch arrays must hold n entries, the result ends up in keys/rows.
+template<class Row>
+static void radixSort(uint64_t* keys, Row* rows, size_t n, unsigned bits, uint64_t* keyScratch, Row* rowScratch) {
+    unsigned passes = (bits + RADIX_BITS - 1) / RADIX_BITS;
+    if (passes <= 2 || n < RADIX_MSD_MIN_ROWS) {
+        lsdRadixSort(keys, rows, n, passes, keyScratch, rowScratch);
+        return;
+    }
+
+    unsigned shift = bits - RADIX_BITS;
+    unsigned lowPasses = (shift + RADIX_BITS - 1) / RADIX_BITS;
+    std::vector<size_t> starts(RADIX_BUCKETS + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        starts[((keys[i] >> shift) & (RADIX_BUCKETS - 1)) + 1]++;
+    }
+    for (size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket) {
+        starts[bucket + 1] += starts[bucket];
+    }
+    std::vector<size_t> next(starts.begin(), starts.end() - 1);
+    for (size_t i = 0; i < n; ++i) {
+        size_t slot = next[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+        keyScratch[slot] = keys[i];
+        rowScratch[slot] = rows[i];
+    }
+    for (size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket) {
+        size_t begin = starts[bucket];
+        lsdRadixSort(keyScratch + begin, rowScratch + begin, starts[bucket + 1] - begin, lowPasses, keys + begin, rows + begin);
+    }
+    std::copy(keyScratch, keyScratch + n, keys);
+    std::copy(rowScratch, rowScratch + n, rows);
+}
+
+// Parallel stable sample sort. Splitters come from a regular sample of the
+// keys; every thread counts and scatters its own contiguous chunk into the
+// buckets, keeping chunk order inside a bucket, and the buckets are then
+// radix sorted independently. Ties therefore keep their input order and the
+// result is the same for every thread count.
+template<class Row>
+static void sampleSort(std::vector<uint64_t>& keys, std::vector<Row>& rows, unsigned bits, size_t threads) {
+    size_t n = keys.size();
+    std::vector<uint64_t> keyScratch(n);
+    std::vector<Row> rowScratch(n);
+    if (threads <= 1 || n < SORT_PARALLEL_MIN_ROWS) {
+        radixSort(keys.data(), rows.data(), n, bits, keyScratch.data(), rowScratch.data());
+        return;
+    }
+
+    size_t numberOfChunks = threads;
+    size_t numberOfBuckets = threads * SORT_BUCKETS_PER_THREAD;
+    size_t chunkSize = (n + numberOfChunks - 1) / numberOfChunks;
+    std::vector<uint64_t> sample(numberOfBuckets * SORT_OVERSAMPLING);
+    for (size_t i = 0; i < sample.size(); ++i) {
+        sample[i] = keys[i * (n / sample.size())];
+    }
+    std::sort(sample.begin(), sample.end());
+    std::vector<uint64_t> splitters;
+    for (size_t bucket = 1; bucket < numberOfBuckets; ++bucket) {
+        splitters.push_back(sample[bucket * SORT_OVERSAMPLING]);
+    }
+    auto bucketOf = [&splitters](uint64_t key) {
+        return static_cast<size_t>(std::upper_bound(splitters.begin(), splitters.end(), key) - splitters.begin());
+    };
+
+    std::vector<size_t> offsets(numberOfChunks * numberOfBuckets, 0);
+    parallelFor(numberOfChunks, threads, [&](size_t chunk, size_t) {
+        size_t* counts = offsets.data() + chunk * numberOfBuckets;
+        for (size_t i = chunk * chunkSize; i < std::min(n, (chunk + 1) * chunkSize); ++i) {
+            counts[bucketOf(keys[i])]++;
+        }
+    });
+    std::vector<size_t> bucketStarts(numberOfBuckets + 1, 0);
+    size_t offset = 0;
+    for (size_t bucket = 0; bucket < numberOfBuckets; ++bucket) {
+        bucketStarts[bucket] = offset;
+        for (size_t chunk = 0; chunk < numberOfChunks; ++chunk) {
+            size_t count = offsets[chunk * numberOfBuckets + bucket];
+            offsets[chunk * numberOfBuckets + bucket] = offset;
+            offset += count;
+        }
+    }
+    bucketStarts[numberOfBuckets] = n;
+    parallelFor(numberOfChunks, threads, [&](size_t chunk, size_t) {
+        size_t* next = offsets.data() + chunk * numberOfBuckets;
+        for (size_t i = chunk * chunkSize; i < std::min(n, (chunk + 1) * chunkSize); ++i) {
+            size_t slot = next[bucketOf(keys[i])]++;
+            keyScratch[slot] = keys[i];
+            rowScratch[slot] = rows[i];
+        }
+    });
+    keys.swap(keyScratch);
+    rows.swap(rowScratch);
+
+    // larger buckets first so a skewed bucket does not start last
+    std::vector<size_t> order(numberOfBuckets);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&bucketStarts](size_t a, size_t b) {
+        return bucketStarts[a + 1] - bucketStarts[a] > bucketStarts[b + 1] - bucketStarts[b];
+    });
+    parallelFor(numberOfBuckets, threads, [&](size_t task, size_t) {
+        size_t bucket = order[task];
+        size_t begin = bucketStarts[bucket];
+        radixSort(keys.data() + begin, rows.data() + begin, bucketStarts[bucket + 1] - begin, bits,
+                  keyScratch.data() + begin, rowScratch.data() + begin);
+    });
+}
+
+// Stable move of the null rows of one key column to the front or the back
+template<class Row>
+static void partitionNulls(const ColumnBuffer& buffer, std::vector<Row>& rows, bool nullsFirst) {
+    size_t nulls = buffer.size() - buffer.getValidity().countValid();
+    std::vector<Row> rowScratch(rows.size());
+    size_t nullSlot = nullsFirst ? 0 : rows.size() - nulls;
+    size_t validSlot = nullsFirst ? nulls : 0;
+    for (Row row : rows) {
+        rowScratch[buffer.isValid(row) ? validSlot++ : nullSlot++] = row;
+    }
+    rows.swap(rowScratch);
+}
+
+// Key columns are sorted from the last to the first. Neighbouring columns
+// whose radix keys fit into 64 bits together are packed into one key and
+// sorted in a single round.
+template<class Row>
+static std::vector<Row> radixPermutation(const std::vector<const ColumnBuffer*>& keys, const std::vector<bool>& ascending, bool nullsFirst, size_t threads) {
+    size_t numberOfRows = keys.front()->size();
+    std::vector<Row> rows(numberOfRows);
+    std::iota(rows.begin(), rows.end(), 0);
+
+    std::optional<RadixKeys> pending;
+    size_t last = keys.size();
+    while (last > 0) {
+        // collect the columns [first, last) that fit into one packed key, a
+        // column that needs a separate null pass is sorted on its own
+        std::vector<RadixKeys> packedColumns;
+        unsigned packedBits = 0;
+        size_t first = last;
+        while (first > 0) {
+            RadixKeys column = pending.has_value() ? std::move(*pending) : radixKeys(*keys[first - 1], ascending[first - 1], nullsFirst, threads);
+            pending.reset();
+            if (!packedColumns.empty() && (column.separateNulls || packedBits + column.bits > 64)) {
+                pending = std::move(column);
+                break;
+            }
+            packedBits += column.bits;
+            packedColumns.insert(packedColumns.begin(), std::move(column));
+            first--;
+            if (packedColumns.front().separateNulls) {
+                break;
+            }
+        }
+
+        std::vector<uint64_t> packed(numberOfRows, 0);
+        forEachRange(numberOfRows, threads, [&](size_t begin, size_t end) {
+            for (const RadixKeys& column : packedColumns) {
+                for (size_t i = begin; i < end; ++i) {
+                    packed[i] = (column.bits == 64 ? 0 : packed[i] << column.bits) | column.keys[rows[i]];
+                }
+            }
+        });
+        bool separateNulls = packedColumns.front().separateNulls;
+        packedColumns.clear();
+        sampleSort(packed, rows, packedBits, threads);
+        if (separateNulls) {
+            partitionNulls(*keys[first], rows, nullsFirst);
+        }
+        last = first;
+    }
+    return rows;
+}
+
+std::vector<size_t> sortPermutation(const std::vector<const ColumnBuffer*>& keys, const std::vector<bool>& ascending, bool nullsFirst, size_t threads) {
+    size_t numberOfRows = keys.empty() ? 0 : keys.front()->size();
+    if (numberOfRows < 2) {
+        return std::vector<size_t>(numberOfRows, 0);
+    }
+    // 32 bit row ids halve the data moved per pass whenever they are enough
+    if (numberOfRows <= std::numeric_limits<uint32_t>::max()) {
+        std::vector<uint32_t> rows = radixPermutation<uint32_t>(keys, ascending, nullsFirst, threads);
+        std::vector<size_t> permutation(numberOfRows);
+        forEachRange(numberOfRows, threads, [&](size_t begin, size_t end) {
+            std::copy(rows.begin() + begin, rows.begin() + end, permutation.begin() + begin);
+        });
+        return permutation;
+    }
+    return radixPermutation<size_t>(keys, ascending, nullsFirst, threads);
+}
+
+bool isSorted(const std::vector<const ColumnBuffer*>& keys, const std::vector<bool>& ascending, bool nullsFirst) {
+    size_t numberOfRows = keys.empty() ? 0 : keys.front()->size();
+    for (size_t row = 1; row < numberOfRows; ++row) {
+        if (compareKeys(keys, ascending, nullsFirst, row - 1, row) > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Keeps the k best rows seen so far in a heap whose top is the worst of them,
+// most rows only cost one comparison against that top.
+template<class Before>
+static void pushBounded(std::vector<size_t>& heap, size_t k, size_t row, const Before& before) {
+    if (heap.size() < k) {
+        heap.push_back(row);
+        std::push_heap(heap.begin(), heap.end(), before);
+    } else if (before(row, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), before);
+        heap.back() = row;
+        std::push_heap(heap.begin(), heap.end(), before);
+    }
+}
+
+template<class Before>
+static std::vector<size_t> selectTop(const std::vector<const ColumnBuffer*>& keys, size_t k, size_t threads, const Before& before) {
+    size_t numberOfRows = keys.front()->size();
+    size_t tasks = std::max<size_t>(1, std::min(threads, (numberOfRows + SORT_RANGE_SIZE - 1) / SORT_RANGE_SIZE));
+    std::vector<std::vector<size_t>> heaps(tasks);
+    parallelFor(tasks, threads, [&](size_t task, size_t) {
+        size_t begin = numberOfRows * task / tasks;
+        size_t end = numberOfRows * (task + 1) / tasks;
+        std::vector<size_t>& heap = heaps[task];
+        heap.reserve(std::min(k, end - begin));
+        for (size_t row = begin; row < end; ++row) {
+            if (!hasNullKey(keys, row)) {
+                pushBounded(heap, k, row, before);
+            }
+        }
+    });
+
+    std::vector<size_t> top = std::move(heaps.front());
+    for (size_t task = 1; task < tasks; ++task) {
+        for (size_t row : heaps[task]) {
+            pushBounded(top, k, row, before);
+        }
+    }
+    std::sort_heap(top.begin(), top.end(), before);
+    return top;
+}
+
+std::vector<size_t> topRows(const std::vector<const ColumnBuffer*>& keys, size_t k, bool largest, size_t threads) {
+    if (keys.empty() || k == 0) {
+        return {};
+    }
+    // typed comparisons for the common single numeric key
+    if (keys.size() == 1 && (keys.front()->kind() == ColumnKind::Int || keys.front()->kind() == ColumnKind::Double)) {
+        return keys.front()->visit([&](const auto& values) -> std::vector<size_t> {
+            using Storage = std::decay_t<decltype(values)>;
+            if constexpr (std::is_same_v<Storage, std::vector<int>> || std::is_same_v<Storage, std::vector<double>>) {
+                return selectTop(keys, k, threads, [&values, largest](size_t a, size_t b) {
+                    if (values[a] < values[b]) return !largest;
+                    if (values[b] < values[a]) return largest;
+                    return a < b;
+                });
+            } else {
+                return {};
+            }
+        });
+    }
+    return selectTop(keys, k, threads, [&keys, largest](size_t a, size_t b) {
+        int order = compareRows(keys, a, keys, b);
+        if (order != 0) {
+            return largest ? order > 0 : order < 0;
+        }
+        return a < b;
+    });
+}
@@ -0,0 +1,271 @@
+#include "../include/view.h"
+#include "../include/dataframe.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// COLUMN SLICE
+
+ColumnSlice::ColumnSlice(std::string name, std::shared_ptr<const ColumnBuffer> buffer, size_t offset, size_t length)
+        : name(std::move(name)), buffer(std::move(buffer)), offset(offset), length(length) {
+    if (offset + length > this->buffer->size()) {
+        throw InvalidIndexException();
+    }
+}
+
+bool ColumnSlice::isNull(size_t index) const {
+    if (index >= this->length) {
+        throw InvalidIndexException();
+    }
+    return !this->buffer->isValid(this->offset + index);
+}
+
+std::optional<ColumnType> ColumnSlice::operator[](size_t index) const {
+    if (index >= this->length) {
+        throw InvalidIndexException();
+    }
+    return this->buffer->get(this->offset + index);
+}
+
+size_t ColumnSlice::countNull() const {
+    return this->length - countValid(this->buffer->getValidity().getWords().data(), this->offset, this->offset + this->length);
+}
+
+ColumnStats ColumnSlice::stats(size_t threads) const {
+    ColumnStats result = rangeStats(*this->buffer, this->offset, this->offset + this->length, threads);
+    if (result.minRow != NO_ROW) {
+        result.minRow -= this->offset;
+        result.maxRow -= this->offset;
+    }
+    return result;
+}
+
+ColumnSlice ColumnSlice::slice(size_t offset, size_t length) const {
+    if (offset > this->length) {
+        throw InvalidIndexException();
+    }
+    return ColumnSlice(this->name, this->buffer, this->offset + offset, std::min(length, this->length - offset));
+}
+
+ColumnSlice ColumnSlice::head(size_t n) const {
+    return this->slice(0, n);
+}
+
+ColumnSlice ColumnSlice::tail(size_t n) const {
+    return this->slice(this->length - std::min(n, this->length), n);
+}
+
+Column<ColumnType> ColumnSlice::toColumn() const {
+    if (this->offset == 0 && this->length == this->buffer->size()) {
+        return Column<ColumnType>(this->name, this->buffer);
+    }
+    return Column<ColumnType>(this->name, this->buffer->slice(this->offset, this->length));
+}
+
+// DATAFRAME VIEW
+
+DataFrameView::DataFrameView(std::vector<std::string> names, std::vector<std::shared_ptr<const ColumnBuffer>> buffers, size_t offset, size_t length)
+        : names(std::move(names)), buffers(std::move(buffers)), offset(offset), length(length) {}
+
+size_t DataFrameView::position(const std::string& columnName) const {
+    for (size_t i = 0; i < this->names.size(); ++i) {
+        if (this->names[i] == columnName) {
+            return i;
+        }
+    }
+    throw std::runtime_error("Column not found");
+}
+
+ColumnSlice DataFrameView::column(const std::string& columnName) const {
+    return this->column(this->position(columnName));
+}
+
+ColumnSlice DataFrameView::column(size_t index) const {
+    if (index >= this->names.size()) {
+        throw InvalidIndexException();
+    }
+    return ColumnSlice(this->names[index], this->buffers[index], this->offset, this->length);
+}
+
+DataFrameView DataFrameView::slice(size_t offset, size_t length) const {
+    if (offset > this->length) {
+        throw InvalidIndexException();
+    }
+    return DataFrameView(this->names, this->buffers, this->offset + offset, std::min(length, this->length - offset));
+}
+
+DataFrameView DataFrameView::head(size_t n) const {
+    return this->slice(0, n);
+}
+
+DataFrameView DataFrameView::tail(size_t n) const {
+    return this->slice(this->length - std::min(n, this->length), n);
+}
+
+DataFrameView DataFrameView::select(const std::vector<std::string>& columnNames) const {
+    std::vector<std::shared_ptr<const ColumnBuffer>> selected;
+    for (const auto& columnName : columnNames) {
+        selected.push_back(this->buffers[this->position(columnName)]);
+    }
+    return DataFrameView(columnNames, std::move(selected), this->offset, this->length);
+}
+
+RowRange DataFrameView::rows() const {
+    auto layout = std::make_shared<RowLayout>();
+    layout->names = this->names;
+    for (const auto& buffer : this->buffers) {
+        layout->buffers.push_back(buffer.get());
+    }
+    layout->offset = this->offset;
+    return RowRange(layout, this->length);
+}
+
+void DataFrameView::print() const {
+    size_t maxWidthFinal = 0;
+
+    for (size_t position = 0; position < this->names.size(); ++position) {
+        size_t maxWidth = this->names[position].size();
+
+        for (size_t row = this->offset; row < this->offset + this->length; ++row) {
+            const auto val = this->buffers[position]->get(row);
+            size_t valueWidth = 0;
+
+            if (val.has_value()) {
+                std::visit([&valueWidth](auto&& v) {
+                    std::ostringstream oss;
+                    oss << v;
+                    valueWidth = oss.str().size();
+                }, val.value());
+            } else {
+                valueWidth = std::string("null").size();
+            }
+
+            maxWidth = std::max(maxWidth, valueWidth);
+        }
+
+        maxWidthFinal = std::max(maxWidth, maxWidthFinal);
+    }
+
+    for (const auto& columnName : this->names) {
+        std::cout << std::setw(maxWidthFinal) << std::left << columnName << " | ";
+    }
+    std::cout << std::endl;
+
+    for (size_t position = 0; position < this->names.size(); ++position) {
+        std::cout << std::setw(maxWidthFinal) << std::left << std::string(this->names.size(), '-') << " | ";
+    }
+    std::cout << std::endl;
+
+    for (const RowView& row : this->rows()) {
+        for (size_t position = 0; position < row.size(); ++position) {
+            const auto val = row[position];
+
+            if (val.has_value()) {
+                std::visit([&](auto&& v) {
+                    std::cout << std::setw(maxWidthFinal) << std::left << v << " | ";
+                }, val.value());
+            } else {
+                std::cout << std::setw(maxWidthFinal) << std::left << "null" << " | ";
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+void DataFrameView::saveCSV(const std::string& filePath, const std::string& separator, bool saveHeaderLine) const {
+    std::ofstream file(filePath);
+    if(!file.is_open()) {
+        throw std::runtime_error("Could not open the file: " + filePath);
+    }
+
+    if(saveHeaderLine) {
+        for(size_t position = 0; position < this->names.size(); position++) {
+            file << this->names[position];
+            if(position + 1 < this->names.size()) {
+                file << separator;
+            }
+        }
+        file << "\n";
+    }
+
+    for(const RowView& row : this->rows()) {
+        for(size_t position = 0; position < row.size(); position++) {
+            const auto cell = row[position];
+            if(cell.has_value()) {
+                std::visit([&file](auto&& val) { file << val; }, cell.value());
+            }
+            if(position + 1 < row.size()) {
+                file << separator;
+            }
+        }
+        file << "\n";
+    }
+    file.close();
+}
+
+std::map<std::string, std::map<std::string, ColumnType>> DataFrameView::aggregate(const std::vector<std::string>& operations) const {
+    std::map<std::string, std::map<std::string, ColumnType>> results;
+    for (size_t position = 0; position < this->names.size(); ++position) {
+        ColumnSlice column = this->column(position);
+        std::map<std::string, ColumnType> columnResults;
+        std::optional<ColumnStats> stats;
+        auto columnStats = [&]() -> const ColumnStats& {
+            if (!stats.has_value()) {
+                stats = column.stats();
+            }
+            return *stats;
+        };
+        auto valueStats = [&]() -> const ColumnStats& {
+            if (column.isEmpty()) {
+                throw EmptyColumnException();
+            }
+            if (columnStats().count == 0) {
+                throw NoValidValuesException();
+            }
+            return *stats;
+        };
+        for (const auto& op : operations) {
+            if (op == "min") {
+                columnResults["min"] = *column[valueStats().minRow];
+            } else if (op == "max") {
+                columnResults["max"] = *column[valueStats().maxRow];
+            } else if (op == "mean") {
+                columnResults["mean"] = valueStats().mean();
+            } else if (op == "std") {
+                columnResults["std"] = valueStats().stddev();
+            } else if (op == "var") {
+                columnResults["var"] = valueStats().variance();
+            } else if (op == "countNull") {
+                columnResults["countNull"] = static_cast<int>(columnStats().nullCount);
+            } else if (op == "nunique") {
+                columnResults["nunique"] = column.toColumn().countDistinct();
+            } else if (op == "median") {
+                columnResults["median"] = column.toColumn().median();
+            } else {
+                throw std::invalid_argument("Unsupported operation: " + op);
+            }
+        }
+        results[this->names[position]] = columnResults;
+    }
+    return results;
+}
+
+std::map<std::string, std::map<std::string, ColumnType>> DataFrameView::describe() const {
+    return this->aggregate({"mean", "std", "var", "min", "max", "median"});
+}
+
+GroupBy DataFrameView::groupBy(const std::vector<std::string>& keys, bool sortGroups) const {
+    for (const auto& key : keys) {
+        this->position(key);
+    }
+    return GroupBy(*this, keys, sortGroups);
+}
+
+DataFrame DataFrameView::toDataFrame() const {
+    DataFrame result;
+    for (size_t position = 0; position < this->names.size(); ++position) {
+        result.addColumn(this->column(position).toColumn());
+    }
+    return result;
+}